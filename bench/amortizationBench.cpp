@@ -0,0 +1,419 @@
+// Benchmarks for the calculator's hot paths: schedule computation, table
+// population, chart series rebuilds, hover lookups and CSV export. Runs
+// headless on the offscreen platform with fixed inputs and prints one JSON
+// document, so results can be diffed between releases.
+//
+// Usage: amortizationBench [--filter <substring>] [--min-time <seconds>]
+//                          [--output <results.json>] [--list]
+
+#include "amortizationEngine.h"
+#include "centsAmortization.h"
+#include "chartDecimation.h"
+#include "hoverIndex.h"
+#include "scheduleExport.h"
+#include "scheduleModel.h"
+#include <QApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QTableView>
+#include <QTemporaryDir>
+#include <QtCharts/QChartView>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps results alive so the optimizer cannot drop the work being timed
+volatile double sink;
+
+struct BenchResult {
+    std::string name;
+    long long iterations = 0; // operations timed, across all samples
+    double minNs = 0, medianNs = 0, meanNs = 0, p95Ns = 0; // per operation
+    double itemsPerSecond = 0;
+    double bytesPerSecond = 0;
+};
+
+struct Benchmark {
+    std::string name;
+    long long items; // processed per operation, for throughput; 0 for none
+    std::function<void()> setUp; // untimed, before the first sample
+    std::function<long long()> operation; // returns bytes processed, or 0
+};
+
+class BenchRunner {
+public:
+    BenchRunner(double minSeconds, std::string filter) : minSeconds(minSeconds), filter(std::move(filter)) {}
+
+    void add(Benchmark benchmark) { benchmarks.push_back(std::move(benchmark)); }
+
+    void list() const {
+        for (const Benchmark &benchmark : benchmarks)
+            std::printf("%s\n", benchmark.name.c_str());
+    }
+
+    std::vector<BenchResult> runAll() {
+        std::vector<BenchResult> results;
+        for (Benchmark &benchmark : benchmarks) {
+            if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+                continue;
+            std::fprintf(stderr, "%s...\n", benchmark.name.c_str());
+            results.push_back(run(benchmark));
+        }
+        return results;
+    }
+
+private:
+    BenchResult run(Benchmark &benchmark) {
+        if (benchmark.setUp)
+            benchmark.setUp();
+        benchmark.operation(); // warm caches and lazy initialization
+
+        // Batch fast operations so each sample is long enough to time reliably
+        long long batch = 1;
+        for (;;) {
+            auto start = Clock::now();
+            for (long long i = 0; i < batch; ++i)
+                benchmark.operation();
+            if (Clock::now() - start >= std::chrono::microseconds(50) || batch >= (1 << 20))
+                break;
+            batch *= 2;
+        }
+
+        std::vector<double> samples; // ns per operation
+        long long bytes = 0;
+        auto deadline = Clock::now() + std::chrono::duration<double>(minSeconds);
+        while (samples.size() < 5 || (Clock::now() < deadline && samples.size() < 100000)) {
+            auto start = Clock::now();
+            for (long long i = 0; i < batch; ++i)
+                bytes += benchmark.operation();
+            std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+            samples.push_back(elapsed.count() / batch);
+        }
+
+        BenchResult result;
+        result.name = benchmark.name;
+        result.iterations = static_cast<long long>(samples.size()) * batch;
+        double total = 0;
+        for (double sample : samples)
+            total += sample;
+        std::sort(samples.begin(), samples.end());
+        result.minNs = samples.front();
+        result.medianNs = samples[samples.size() / 2];
+        result.meanNs = total / samples.size();
+        result.p95Ns = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+        double seconds = total * batch * 1e-9;
+        if (benchmark.items > 0)
+            result.itemsPerSecond = benchmark.items * double(result.iterations) / seconds;
+        if (bytes > 0)
+            result.bytesPerSecond = bytes / seconds;
+        return result;
+    }
+
+    double minSeconds;
+    std::string filter;
+    std::vector<Benchmark> benchmarks;
+};
+
+void writeJson(std::FILE *out, const std::vector<BenchResult> &results, double minSeconds) {
+    std::fprintf(out, "{\n");
+    std::fprintf(out, "  \"suite\": \"amortizationBench\",\n");
+    std::fprintf(out, "  \"schemaVersion\": 1,\n");
+    std::fprintf(out, "  \"qtVersion\": \"%s\",\n", qVersion());
+    std::fprintf(out, "  \"hardwareThreads\": %u,\n", std::thread::hardware_concurrency());
+    std::fprintf(out, "  \"minTimeSeconds\": %g,\n", minSeconds);
+    std::fprintf(out, "  \"results\": [\n");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &r = results[i];
+        std::fprintf(out,
+                     "    {\"name\": \"%s\", \"iterations\": %lld, \"minNs\": %.1f, \"medianNs\": %.1f, "
+                     "\"meanNs\": %.1f, \"p95Ns\": %.1f, \"itemsPerSecond\": %.1f, \"bytesPerSecond\": %.1f}%s\n",
+                     r.name.c_str(), r.iterations, r.minNs, r.medianNs, r.meanNs, r.p95Ns, r.itemsPerSecond,
+                     r.bytesPerSecond, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+LoanTerms benchTerms(int months) {
+    return {250000.0, 6.5, months};
+}
+
+// Cumulative chart points as AmortizationCalc::updateChart() builds them
+void buildChartPoints(const Schedule &schedule, QList<QPointF> &principal, QList<QPointF> &interest,
+                      QList<QPointF> &total) {
+    const int months = schedule.periods;
+    principal.resize(months);
+    interest.resize(months);
+    total.resize(months);
+    for (int row = 0; row < months; ++row) {
+        double x = row + 1;
+        principal[row] = QPointF(x, schedule.cumulativePrincipal[row]);
+        interest[row] = QPointF(x, schedule.cumulativeInterest[row]);
+        total[row] = QPointF(x, schedule.cumulativePrincipal[row] + schedule.cumulativeInterest[row]);
+    }
+}
+
+// A schedule with its model, table and chart, sized like the main window
+struct Fixture {
+    explicit Fixture(int months) {
+        amortize(benchTerms(months), schedule);
+        model = new ScheduleModel(&schedule);
+        table.setModel(model);
+        table.verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        table.resize(600, 800);
+
+        chart = new QChart();
+        for (QLineSeries *&series : lines) {
+            series = new QLineSeries();
+            chart->addSeries(series);
+        }
+        axisX = new QValueAxis;
+        axisY = new QValueAxis;
+        chart->addAxis(axisX, Qt::AlignBottom);
+        chart->addAxis(axisY, Qt::AlignLeft);
+        for (QLineSeries *series : lines) {
+            series->attachAxis(axisX);
+            series->attachAxis(axisY);
+        }
+        axisX->setRange(1, months);
+        axisY->setRange(0, schedule.cumulativePrincipal[months - 1] + schedule.cumulativeInterest[months - 1]);
+        chartView.setChart(chart);
+        chartView.resize(1000, 700);
+        chartView.show();
+        QApplication::processEvents(); // settle the layout and plot area
+    }
+
+    ~Fixture() { delete model; }
+
+    void rebuildSeries() {
+        buildChartPoints(schedule, points[0], points[1], points[2]);
+        const int maxPoints = std::max(100, int(chart->plotArea().width()));
+        for (int i = 0; i < 3; ++i)
+            lines[i]->replace(decimateMinMax(points[i], axisX->min(), axisX->max(), maxPoints));
+    }
+
+    Schedule schedule;
+    ScheduleModel *model;
+    QTableView table;
+    QChartView chartView;
+    QChart *chart;
+    QLineSeries *lines[3];
+    QValueAxis *axisX;
+    QValueAxis *axisY;
+    QList<QPointF> points[3];
+};
+
+void registerBenchmarks(BenchRunner &runner, const QString &tempDir) {
+    const int sizes[] = {12, 360, 1200, 100000};
+
+    // Schedule computation
+    for (int months : sizes) {
+        auto schedule = std::make_shared<Schedule>();
+        runner.add({"compute/amortize/" + std::to_string(months), months, {}, [schedule, months]() {
+                        amortize(benchTerms(months), *schedule);
+                        sink = schedule->totalInterest;
+                        return 0LL;
+                    }});
+    }
+    for (int months : sizes) {
+        // Whole-cent engine, for comparison with the double path above
+        auto schedule = std::make_shared<Schedule>();
+        runner.add({"compute/amortizeCents/" + std::to_string(months), months, {}, [schedule, months]() {
+                        amortizeCents<Rounding::HalfEven>(benchTerms(months), *schedule);
+                        sink = schedule->totalInterest;
+                        return 0LL;
+                    }});
+    }
+    for (int months : sizes) {
+        // Editing a one-time payment five sixths of the way through the term
+        auto schedule = std::make_shared<Schedule>();
+        const int row = months * 5 / 6;
+        runner.add({"compute/amortizeFrom/" + std::to_string(months), months - row,
+                    [schedule, months]() { amortize(benchTerms(months), *schedule); },
+                    [schedule, months, row]() {
+                        schedule->prepayment[row] = 100.0;
+                        amortizeFrom(benchTerms(months), *schedule, row);
+                        sink = schedule->totalInterest;
+                        return 0LL;
+                    }});
+    }
+
+    // Table population: publish the schedule, then format the cells of one
+    // screen of rows (what a view asks for), or paint the whole table
+    for (int months : {360, 100000}) {
+        auto fixture = std::make_shared<std::unique_ptr<Fixture>>();
+        auto setUp = [fixture, months]() { *fixture = std::make_unique<Fixture>(months); };
+        runner.add({"table/populate/" + std::to_string(months), 0, setUp, [fixture]() {
+                        ScheduleModel *model = (*fixture)->model;
+                        model->reload();
+                        int rows = std::min(40, model->rowCount());
+                        long long chars = 0;
+                        for (int row = 0; row < rows; ++row) {
+                            for (int column = 0; column < ScheduleModel::ColumnCount; ++column)
+                                chars += model->data(model->index(row, column)).toString().size();
+                        }
+                        sink = double(chars);
+                        return 0LL;
+                    }});
+        runner.add({"table/paint/" + std::to_string(months), 0, setUp, [fixture]() {
+                        (*fixture)->model->reload();
+                        sink = (*fixture)->table.grab().width();
+                        return 0LL;
+                    }});
+    }
+
+    // Chart series rebuild (points, decimation and replace), with and without painting
+    for (int months : {360, 1200, 100000}) {
+        auto fixture = std::make_shared<std::unique_ptr<Fixture>>();
+        auto setUp = [fixture, months]() { *fixture = std::make_unique<Fixture>(months); };
+        runner.add({"chart/rebuild/" + std::to_string(months), months, setUp, [fixture]() {
+                        (*fixture)->rebuildSeries();
+                        sink = (*fixture)->lines[0]->count();
+                        return 0LL;
+                    }});
+        runner.add({"chart/paint/" + std::to_string(months), 0, setUp, [fixture]() {
+                        (*fixture)->rebuildSeries();
+                        sink = (*fixture)->chartView.grab().width();
+                        return 0LL;
+                    }});
+    }
+
+    // Nearest point for one mouse move, including the tooltip text the
+    // event filter builds; positions are a fixed pseudo-random sequence
+    for (int months : {360, 100000}) {
+        auto fixture = std::make_shared<std::unique_ptr<Fixture>>();
+        auto index = std::make_shared<HoverIndex>();
+        auto positions = std::make_shared<std::vector<QPointF>>();
+        auto next = std::make_shared<std::size_t>(0);
+        runner.add({"hover/nearest/" + std::to_string(months), 0,
+                    [fixture, index, positions, months]() {
+                        *fixture = std::make_unique<Fixture>(months);
+                        Fixture &f = **fixture;
+                        f.rebuildSeries();
+                        QRectF plotArea = f.chart->plotArea();
+                        QRectF dataRange(f.axisX->min(), f.axisY->min(), f.axisX->max() - f.axisX->min(),
+                                         f.axisY->max() - f.axisY->min());
+                        index->rebuild(plotArea, dataRange,
+                                       {f.lines[0]->points(), f.lines[1]->points(), f.lines[2]->points()});
+                        std::mt19937 random(12345);
+                        positions->resize(4096);
+                        for (QPointF &position : *positions) {
+                            position = QPointF(plotArea.left() + plotArea.width() * (random() / 4294967296.0),
+                                               plotArea.top() + plotArea.height() * (random() / 4294967296.0));
+                        }
+                    },
+                    [index, positions, next]() {
+                        const QPointF &position = (*positions)[(*next)++ % positions->size()];
+                        HoverIndex::Hit hit = index->nearest(position, 10.0);
+                        if (hit.series >= 0) {
+                            QString tip = QString("%1\nX: %2\nY: %3")
+                                              .arg(hit.series)
+                                              .arg(hit.point.x())
+                                              .arg(hit.point.y(), 0, 'f', 2);
+                            sink = tip.size();
+                        }
+                        return 0LL;
+                    }});
+        runner.add({"hover/rebuild/" + std::to_string(months), 0,
+                    [fixture, months]() {
+                        *fixture = std::make_unique<Fixture>(months);
+                        (*fixture)->rebuildSeries();
+                    },
+                    [fixture, index]() {
+                        Fixture &f = **fixture;
+                        QRectF dataRange(f.axisX->min(), f.axisY->min(), f.axisX->max() - f.axisX->min(),
+                                         f.axisY->max() - f.axisY->min());
+                        index->rebuild(f.chart->plotArea(), dataRange,
+                                       {f.lines[0]->points(), f.lines[1]->points(), f.lines[2]->points()});
+                        sink = index->isValid();
+                        return 0LL;
+                    }});
+    }
+
+    // CSV export throughput to a scratch file
+    for (int months : {360, 100000}) {
+        auto schedule = std::make_shared<Schedule>();
+        std::string path = QDir(tempDir).filePath(QString("export-%1.csv").arg(months)).toStdString();
+        runner.add({"export/csv/" + std::to_string(months), months,
+                    [schedule, months]() { amortize(benchTerms(months), *schedule); },
+                    [schedule, path]() {
+                        if (exportSchedulesCsv(path, {schedule.get()}) != ExportStatus::Ok)
+                            return 0LL;
+                        return static_cast<long long>(QFileInfo(QString::fromStdString(path)).size());
+                    }});
+    }
+}
+
+void printUsage() {
+    std::fprintf(stderr,
+        "Usage: amortizationBench [--filter <substring>] [--min-time <seconds>]\n"
+        "                         [--output <results.json>] [--list]\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    // Results must not depend on a display being available
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    std::string filter;
+    std::string output;
+    double minSeconds = 0.5;
+    bool listOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--filter") == 0 && hasValue) {
+            filter = argv[++i];
+        } else if (std::strcmp(arg, "--min-time") == 0 && hasValue) {
+            minSeconds = std::atof(argv[++i]);
+        } else if ((std::strcmp(arg, "--output") == 0 || std::strcmp(arg, "-o") == 0) && hasValue) {
+            output = argv[++i];
+        } else if (std::strcmp(arg, "--list") == 0) {
+            listOnly = true;
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    QApplication app(argc, argv);
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        std::fprintf(stderr, "Cannot create a scratch directory\n");
+        return 1;
+    }
+
+    BenchRunner runner(minSeconds, filter);
+    registerBenchmarks(runner, tempDir.path());
+    if (listOnly) {
+        runner.list();
+        return 0;
+    }
+
+    std::vector<BenchResult> results = runner.runAll();
+
+    std::FILE *out = output.empty() ? stdout : std::fopen(output.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "Cannot write %s\n", output.c_str());
+        return 1;
+    }
+    writeJson(out, results, minSeconds);
+    if (out != stdout)
+        std::fclose(out);
+    return 0;
+}
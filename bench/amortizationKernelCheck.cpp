@@ -0,0 +1,175 @@
+// Checks every batch kernel this CPU can run (scalar, AVX2, AVX-512) against
+// the scalar engine on generated loans: ragged terms within one block,
+// 1-month terms, prepayments and early payoff, and invalid loans. Compares
+// the summaries from summarizeLoans() and, for a few blocks, every row from
+// stepLoanBatch(). Exits with 1 on any difference beyond the tolerance.
+//
+// Usage: amortizationKernelCheck [--loans N] [--seed N]
+
+#include "batchKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Same tolerance as --batch --verify, also applied to single amounts
+bool close(double expected, double actual, double scale) {
+    return std::fabs(expected - actual) <= 1e-9 * std::max(1.0, scale);
+}
+
+// Loans whose terms vary within every block; some blocks are all short or
+// all prepaid early so whole blocks pay off before their longest term.
+std::vector<LoanRecord> makeLoans(int count, unsigned seed) {
+    std::mt19937_64 random(seed);
+    std::uniform_real_distribution<double> principal(1000, 900000);
+    std::uniform_real_distribution<double> rate(0.5, 15.0);
+    std::uniform_int_distribution<int> months(1, 480);
+    std::uniform_int_distribution<int> pick(0, 99);
+
+    std::vector<LoanRecord> loans(count);
+    for (int i = 0; i < count; ++i) {
+        LoanRecord &loan = loans[i];
+        const int block = i / 512;
+        loan.terms.principal = principal(random);
+        loan.terms.annualRate = rate(random);
+        loan.terms.months = block % 4 == 1 ? 1 + pick(random) % 3 : months(random);
+        int kind = pick(random);
+        if (kind < 3)
+            loan.terms.months = 1;
+        else if (kind < 4)
+            loan.terms.annualRate = 0.0; // invalid, summarized as zeros
+
+        // Up to three one-time payments; block 2 mod 4 gets one large enough
+        // to pay each loan off within its first year
+        int payments = block % 4 == 2 ? 1 : pick(random) % 4;
+        for (int p = 0; p < payments; ++p) {
+            Prepayment payment;
+            payment.month = 1 + static_cast<int>(random() % static_cast<unsigned>(std::max(1, loan.terms.months)));
+            payment.amount = pick(random) < 20 ? loan.terms.principal : principal(random) / 20;
+            if (block % 4 == 2) {
+                payment.month = std::min(payment.month, 12);
+                payment.amount = loan.terms.principal;
+            }
+            loan.prepayments.push_back(payment);
+        }
+    }
+    return loans;
+}
+
+long long checkSummaries(const std::vector<LoanRecord> &loans) {
+    std::vector<LoanSummary> summaries;
+    summarizeLoans(loans.data(), static_cast<int>(loans.size()), summaries);
+
+    long long mismatches = 0;
+    Schedule schedule;
+    for (std::size_t i = 0; i < loans.size(); ++i) {
+        const LoanSummary &summary = summaries[i];
+        bool ok;
+        if (amortize(loans[i], schedule)) {
+            ok = schedule.paidOffPeriod == summary.paidOffPeriod
+                && close(schedule.monthlyPayment, summary.monthlyPayment, schedule.monthlyPayment)
+                && close(schedule.totalInterest, summary.totalInterest, schedule.totalInterest);
+        } else {
+            ok = summary.paidOffPeriod == 0 && summary.monthlyPayment == 0.0 && summary.totalInterest == 0.0;
+        }
+        if (!ok && ++mismatches <= 5) {
+            std::fprintf(stderr, "  loan %zu: paid off %d vs %d, interest %.6f vs %.6f\n", i, schedule.paidOffPeriod,
+                         summary.paidOffPeriod, schedule.totalInterest, summary.totalInterest);
+        }
+    }
+    return mismatches;
+}
+
+// Steps one block month by month and compares every row with amortize().
+long long checkRows(const LoanRecord *loans, int count) {
+    std::vector<LoanTerms> terms(count);
+    for (int i = 0; i < count; ++i)
+        terms[i] = loans[i].terms;
+    LoanBatch batch;
+    batch.assign(terms.data(), count);
+
+    std::vector<Schedule> expected(count);
+    for (int i = 0; i < count; ++i)
+        amortize(loans[i], expected[i]);
+
+    std::vector<double> prepayment(batch.lanes);
+    std::vector<double> payment(batch.lanes), principal(batch.lanes), interest(batch.lanes), balance(batch.lanes);
+    BatchRows rows;
+    rows.payment = payment.data();
+    rows.principal = principal.data();
+    rows.interest = interest.data();
+    rows.balance = balance.data();
+
+    long long mismatches = 0;
+    for (int period = 0; period < batch.periods; ++period) {
+        std::fill(prepayment.begin(), prepayment.end(), 0.0);
+        for (int i = 0; i < count; ++i) {
+            if (period < expected[i].periods)
+                prepayment[i] = expected[i].prepayment[period];
+        }
+        BatchTotals totals;
+        stepLoanBatch(batch, period, prepayment.data(), &rows, &totals);
+
+        double sumInterest = 0.0;
+        for (int i = 0; i < count; ++i) {
+            const Schedule &s = expected[i];
+            // Rows after payoff (or past the term) are zero in the batch
+            bool live = period < s.paidOffPeriod;
+            double scale = s.periods > 0 ? s.payment[0] + s.balance[0] : 1.0;
+            bool ok = close(live ? s.payment[period] : 0.0, payment[i], scale)
+                && close(live ? s.principal[period] : 0.0, principal[i], scale)
+                && close(live ? s.interest[period] : 0.0, interest[i], scale)
+                && close(live ? s.balance[period] : 0.0, balance[i], scale);
+            sumInterest += live ? s.interest[period] : 0.0;
+            if (!ok && ++mismatches <= 5)
+                std::fprintf(stderr, "  row %d of loan %d differs\n", period + 1, i);
+        }
+        if (!close(sumInterest, totals.interest, sumInterest) && ++mismatches <= 5)
+            std::fprintf(stderr, "  interest total of month %d differs\n", period + 1);
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int count = 200000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--loans") == 0 && i + 1 < argc) {
+            count = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::fprintf(stderr, "Usage: amortizationKernelCheck [--loans N] [--seed N]\n");
+            return 2;
+        }
+    }
+
+    std::vector<LoanRecord> loans = makeLoans(std::max(count, 1), seed);
+    long long total = 0;
+    for (const char *name : {"scalar", "avx2", "avx512"}) {
+        if (!setLoanBatchKernel(name)) {
+            std::printf("%-7s not supported on this CPU, skipped\n", name);
+            continue;
+        }
+        long long mismatches = checkSummaries(loans);
+        // A ragged block that is not a whole number of vectors, and the
+        // first block of each kind
+        const int rowBlocks[][2] = {{0, 37}, {512, 512}, {1024, 512}, {1536, 512}};
+        for (const auto &block : rowBlocks) {
+            int n = std::min(block[1], static_cast<int>(loans.size()) - block[0]);
+            if (n > 0)
+                mismatches += checkRows(loans.data() + block[0], n);
+        }
+        std::printf("%-7s %zu loans: %lld mismatches\n", name, loans.size(), mismatches);
+        total += mismatches;
+    }
+    return total == 0 ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+// Load generator for server mode (amortizationCalcQt --serve). Opens several
+// connections, keeps a fixed number of requests in flight on each and reports
+// throughput and latency percentiles, measured from when a request is written
+// to when its answer has been read.
+//
+// Usage: amortizationLoadGen (--socket <path> | --port N) [--connections N]
+//                            [--requests N] [--pipeline N]
+//                            [--op summary|schedule|query|mix] [--binary]
+
+#include "quantileSketch.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadOptions {
+    std::string socketPath;
+    int port = 0;
+    int connections = 8;
+    long long requests = 100000; // across all connections
+    int pipeline = 16;           // requests in flight per connection
+    std::string op = "summary";
+    bool binary = false;
+};
+
+struct ClientResult {
+    QuantileSketch latency{0.1}; // microseconds
+    long long answered = 0;
+    long long errors = 0;
+    long long bytes = 0;
+    bool failed = false;
+};
+
+void printUsage() {
+    std::fprintf(stderr,
+        "Usage: amortizationLoadGen (--socket <path> | --port N) [--connections N]\n"
+        "                           [--requests N] [--pipeline N]\n"
+        "                           [--op summary|schedule|query|mix] [--binary]\n");
+}
+
+bool parseOptions(int argc, char *argv[], LoadOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--socket") == 0 && hasValue) {
+            options.socketPath = argv[++i];
+        } else if (std::strcmp(arg, "--port") == 0 && hasValue) {
+            options.port = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--connections") == 0 && hasValue) {
+            options.connections = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--requests") == 0 && hasValue) {
+            options.requests = std::atoll(argv[++i]);
+        } else if (std::strcmp(arg, "--pipeline") == 0 && hasValue) {
+            options.pipeline = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--op") == 0 && hasValue) {
+            options.op = argv[++i];
+        } else if (std::strcmp(arg, "--binary") == 0) {
+            options.binary = true;
+        } else {
+            return false;
+        }
+    }
+    bool knownOp = options.op == "summary" || options.op == "schedule" || options.op == "query" || options.op == "mix";
+    return knownOp && options.socketPath.empty() != (options.port == 0) && options.connections >= 1
+        && options.requests >= 1 && options.pipeline >= 1;
+}
+
+int connectTo(const LoadOptions &options) {
+    int fd = -1;
+    if (!options.socketPath.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, options.socketPath.c_str(), sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        int on = 1;
+        if (fd >= 0)
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+// A random but plausible loan, as a request line.
+std::string makeRequest(std::mt19937_64 &random, const std::string &op, bool binary, long long id) {
+    std::uniform_real_distribution<double> principal(50000, 900000);
+    std::uniform_real_distribution<double> rate(2.0, 9.0);
+    std::uniform_int_distribution<int> years(5, 30);
+    std::uniform_int_distribution<int> pick(0, 9);
+
+    // The mix is mostly summaries, as a pricing front end would send
+    std::string chosen = op;
+    if (op == "mix") {
+        int p = pick(random);
+        chosen = p < 7 ? "summary" : p < 9 ? "query" : "schedule";
+    }
+    int term = years(random);
+    char line[256];
+    int n = std::snprintf(line, sizeof(line),
+                          "{\"id\":%lld,\"op\":\"%s\",\"principal\":%.2f,\"rate\":%.3f,\"term\":%d,\"units\":\"years\"",
+                          id, chosen.c_str(), principal(random), rate(random), term);
+    std::string request(line, static_cast<std::size_t>(n));
+    if (pick(random) < 3) {
+        n = std::snprintf(line, sizeof(line), ",\"prepayments\":[[12,%d],[%d,%d]]", 1000 * (1 + pick(random)),
+                          24 + pick(random) * 6, 500 * (1 + pick(random)));
+        request.append(line, static_cast<std::size_t>(n));
+    }
+    if (chosen == "query") {
+        n = std::snprintf(line, sizeof(line), ",\"month\":%d", 1 + static_cast<int>(random() % (term * 12)));
+        request.append(line, static_cast<std::size_t>(n));
+    }
+    if (chosen == "schedule" && binary)
+        request += ",\"format\":\"binary\"";
+    request += "}\n";
+    return request;
+}
+
+bool sendAll(int fd, const std::string &data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+// Reads whole answers off a blocking socket. Binary schedule answers are a
+// {"bytes":N} line followed by N raw bytes.
+class AnswerReader {
+public:
+    explicit AnswerReader(int fd) : fd(fd) {}
+
+    // Returns the answer's JSON line, or false once the connection fails.
+    bool next(std::string &line, long long &bytes) {
+        std::size_t end;
+        while ((end = buffer.find('\n', start)) == std::string::npos) {
+            if (!fill())
+                return false;
+        }
+        line.assign(buffer, start, end - start);
+        start = end + 1;
+        bytes = static_cast<long long>(line.size()) + 1;
+
+        std::size_t field = line.find("\"bytes\":");
+        if (field == std::string::npos)
+            return true;
+        std::size_t payload = std::strtoull(line.c_str() + field + 8, nullptr, 10);
+        while (buffer.size() - start < payload) {
+            if (!fill())
+                return false;
+        }
+        start += payload;
+        bytes += static_cast<long long>(payload);
+        return true;
+    }
+
+private:
+    bool fill() {
+        if (start > 0) {
+            buffer.erase(0, start);
+            start = 0;
+        }
+        char chunk[64 << 10];
+        ssize_t n;
+        do {
+            n = recv(fd, chunk, sizeof(chunk), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, static_cast<std::size_t>(n));
+        return true;
+    }
+
+    int fd;
+    std::string buffer;
+    std::size_t start = 0;
+};
+
+// One connection: writes requests until pipeline are outstanding, then reads
+// an answer before writing the next.
+void runClient(const LoadOptions &options, int index, long long requests, ClientResult &result) {
+    int fd = connectTo(options);
+    if (fd < 0) {
+        result.failed = true;
+        return;
+    }
+    std::mt19937_64 random(0x5eed + index);
+    AnswerReader reader(fd);
+    std::deque<Clock::time_point> sentAt;
+    std::string line;
+    std::string batch;
+    long long written = 0;
+
+    while (result.answered < requests) {
+        batch.clear();
+        while (written < requests && static_cast<int>(sentAt.size()) < options.pipeline) {
+            batch += makeRequest(random, options.op, options.binary, written);
+            sentAt.push_back(Clock::now());
+            ++written;
+        }
+        if (!batch.empty() && !sendAll(fd, batch)) {
+            result.failed = true;
+            break;
+        }
+        long long bytes = 0;
+        if (!reader.next(line, bytes)) {
+            result.failed = true;
+            break;
+        }
+        double micros = std::chrono::duration<double, std::micro>(Clock::now() - sentAt.front()).count();
+        sentAt.pop_front();
+        result.latency.add(micros);
+        result.bytes += bytes;
+        if (line.find("\"error\"") != std::string::npos)
+            ++result.errors;
+        ++result.answered;
+    }
+    close(fd);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    LoadOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<ClientResult> results(options.connections);
+    std::vector<std::thread> clients;
+    auto start = Clock::now();
+    for (int i = 0; i < options.connections; ++i) {
+        long long share = options.requests / options.connections + (i < options.requests % options.connections ? 1 : 0);
+        clients.emplace_back(runClient, std::cref(options), i, share, std::ref(results[i]));
+    }
+    for (std::thread &client : clients)
+        client.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    QuantileSketch latency(0.1);
+    long long answered = 0;
+    long long errors = 0;
+    long long bytes = 0;
+    int failed = 0;
+    for (const ClientResult &result : results) {
+        latency.merge(result.latency);
+        answered += result.answered;
+        errors += result.errors;
+        bytes += result.bytes;
+        failed += result.failed ? 1 : 0;
+    }
+
+    std::printf("%lld %s requests over %d connections (pipeline %d) in %.3f s\n", answered, options.op.c_str(),
+                options.connections, options.pipeline, seconds);
+    std::printf("throughput: %.0f requests/s, %.1f MB/s received\n", seconds > 0 ? answered / seconds : 0.0,
+                seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+    std::printf("latency us: p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n", latency.quantile(0.5),
+                latency.quantile(0.9), latency.quantile(0.99), latency.quantile(0.999), latency.quantile(1.0));
+    if (errors > 0)
+        std::printf("error answers: %lld\n", errors);
+    if (failed > 0) {
+        std::fprintf(stderr, "%d connections failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
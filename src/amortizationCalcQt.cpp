@@ -1,9 +1,18 @@
 #include "amortizationCalcQt.h"
+#include "chartDecimation.h"
+#include "hoverIndex.h"
+#include "batchMode.h"
+#include "scheduleExport.h"
+#include "scheduleFile.h"
+#include "serveMode.h"
+#include "phaseTimer.h"
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
 #include <QtCharts/QValueAxis>
+#include <QtCharts/QAreaSeries>
 #include <QFormLayout>
 #include <QDoubleValidator>
+#include <QIntValidator>
 #include <QVBoxLayout>
 #include <QHeaderView>
 #include <cmath>
@@ -11,12 +20,20 @@
 #include <QLocale>
 #include <QApplication>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QFile>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QProgressDialog>
+#include <QtConcurrent/QtConcurrentRun>
+#include <memory>
 #include <QToolTip>
 #include <QTimer>
 #include <QMouseEvent>
+#include <QSignalBlocker>
+#include <QSettings>
+#include <QPen>
 #include <limits>
+#include <cstring>
 
 AmortizationCalc::AmortizationCalc(QWidget *parent) : QWidget(parent) {
     auto *mainLayout = new QHBoxLayout(this);
@@ -36,17 +53,34 @@ AmortizationCalc::AmortizationCalc(QWidget *parent) : QWidget(parent) {
     termTypeBox->addItem("Months");
 
     form->addRow("Principal ($):", principalEdit);
-    form->addRow("Annual Interest Rate (%):", rateEdit);
+    rateSlider = new QSlider(Qt::Horizontal);
+    rateSlider->setRange(0, 2000); // hundredths of a percent, 0-20%
+    auto *rateRowLayout = new QHBoxLayout();
+    rateRowLayout->addWidget(rateEdit);
+    rateRowLayout->addWidget(rateSlider);
+    form->addRow("Annual Interest Rate (%):", rateRowLayout);
     termLabel = new QLabel("Term:");
     auto *termRowLayout = new QHBoxLayout();
     termRowLayout->addWidget(termEdit);
     termRowLayout->addWidget(termTypeBox);
     form->addRow(termLabel, termRowLayout);
 
+    // Order matches the Arithmetic enum
+    arithmeticBox = new QComboBox();
+    arithmeticBox->addItem("Floating Point");
+    arithmeticBox->addItem("Exact Cents (Banker's Rounding)");
+    arithmeticBox->addItem("Exact Cents (Round Half Up)");
+    arithmeticBox->addItem("Exact Cents (Truncate)");
+    form->addRow("Arithmetic:", arithmeticBox);
+
     leftLayout->addLayout(form);
 
     calcButton = new QPushButton("Calculate");
-    leftLayout->addWidget(calcButton);
+    liveBox = new QCheckBox("Live Update");
+    auto *calcRowLayout = new QHBoxLayout();
+    calcRowLayout->addWidget(calcButton, 1);
+    calcRowLayout->addWidget(liveBox);
+    leftLayout->addLayout(calcRowLayout);
 
     resultLabel = new QLabel();
     leftLayout->addWidget(resultLabel);
@@ -60,10 +94,9 @@ AmortizationCalc::AmortizationCalc(QWidget *parent) : QWidget(parent) {
     totalPaidLabel = new QLabel(); // <-- Add this line
     leftLayout->addWidget(totalPaidLabel); // <-- Add this line
 
-    table = new QTableWidget();
-    table->setColumnCount(6); // <-- Change to 6 columns
-    QStringList headers = {"Payment #", "Payment", "Principal", "Interest", "Balance", "One-Time Payment"}; // <-- Add column
-    table->setHorizontalHeaderLabels(headers);
+    scheduleModel = new ScheduleModel(&schedule, this);
+    table = new QTableView();
+    table->setModel(scheduleModel);
     table->setColumnWidth(0, 80); // Make "Payment #" column wider so full text is visible
 
     table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Fixed);         // First column fixed
@@ -71,17 +104,52 @@ AmortizationCalc::AmortizationCalc(QWidget *parent) : QWidget(parent) {
     for (int i = 1; i < 5; ++i) {
         table->horizontalHeader()->setSectionResizeMode(i, QHeaderView::Interactive);
     }
-
-    // Left-justify all header titles
-    for (int i = 0; i < headers.size(); ++i) {
-        QTableWidgetItem *headerItem = table->horizontalHeaderItem(i);
-        if (headerItem) {
-            headerItem->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
-        }
-    }
+    // Uniform row heights keep the view cheap no matter how long the schedule is
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
 
     leftLayout->addWidget(table);
 
+    // Recurring extra payments, kept as rules rather than expanded per month
+    auto *ruleLayout = new QHBoxLayout();
+    ruleAmountEdit = new QLineEdit();
+    ruleAmountEdit->setPlaceholderText("Amount");
+    ruleAmountEdit->setValidator(new QDoubleValidator(0, 1e9, 2, this));
+    ruleIntervalEdit = new QLineEdit("1");
+    ruleIntervalEdit->setValidator(new QIntValidator(1, 1200, this));
+    ruleFirstMonthEdit = new QLineEdit("1");
+    ruleFirstMonthEdit->setValidator(new QIntValidator(1, 12000, this));
+    ruleLastMonthEdit = new QLineEdit();
+    ruleLastMonthEdit->setPlaceholderText("end");
+    ruleLastMonthEdit->setValidator(new QIntValidator(1, 12000, this));
+    addRuleButton = new QPushButton("Add Recurring Payment");
+    ruleLayout->addWidget(new QLabel("$"));
+    ruleLayout->addWidget(ruleAmountEdit);
+    ruleLayout->addWidget(new QLabel("every"));
+    ruleLayout->addWidget(ruleIntervalEdit);
+    ruleLayout->addWidget(new QLabel("months from month"));
+    ruleLayout->addWidget(ruleFirstMonthEdit);
+    ruleLayout->addWidget(new QLabel("to"));
+    ruleLayout->addWidget(ruleLastMonthEdit);
+    ruleLayout->addWidget(addRuleButton);
+    leftLayout->addLayout(ruleLayout);
+
+    ruleList = new QListWidget();
+    ruleList->setMaximumHeight(60);
+    leftLayout->addWidget(ruleList);
+    auto *paymentButtonsLayout = new QHBoxLayout();
+    removeRuleButton = new QPushButton("Remove Recurring Payment");
+    importPaymentsButton = new QPushButton("Import Payments...");
+    clearPaymentsButton = new QPushButton("Clear All Payments");
+    paymentButtonsLayout->addWidget(removeRuleButton);
+    paymentButtonsLayout->addWidget(importPaymentsButton);
+    paymentButtonsLayout->addWidget(clearPaymentsButton);
+    leftLayout->addLayout(paymentButtonsLayout);
+
+    connect(addRuleButton, &QPushButton::clicked, this, &AmortizationCalc::addPrepaymentRule);
+    connect(removeRuleButton, &QPushButton::clicked, this, &AmortizationCalc::removePrepaymentRule);
+    connect(importPaymentsButton, &QPushButton::clicked, this, &AmortizationCalc::importPrepaymentFile);
+    connect(clearPaymentsButton, &QPushButton::clicked, this, &AmortizationCalc::clearPrepayments);
+
     mainLayout->addLayout(leftLayout, 1);   // half width
 
     // Right side: chart
@@ -129,11 +197,58 @@ AmortizationCalc::AmortizationCalc(QWidget *parent) : QWidget(parent) {
 
     chartView = new QChartView(chart);
     chartView->setRenderHint(QPainter::Antialiasing);
+    // Drag to zoom into a range of months; right-click zooms back out
+    chartView->setRubberBand(QChartView::HorizontalRubberBand);
+
+    // Re-decimate for the new range or width so zooming refines detail
+    connect(axisX, &QValueAxis::rangeChanged, this, [this]() {
+        if (!updatingAxes)
+            refreshSeries();
+    });
+    connect(chart, &QChart::plotAreaChanged, this, [this](const QRectF &plotArea) {
+        if (int(plotArea.width()) != lastPlotWidth) {
+            lastPlotWidth = int(plotArea.width());
+            refreshSeries();
+        }
+    });
 
-    mainLayout->addWidget(chartView, 1);
+    // Right side: chart above the sensitivity heatmap
+    auto *rightLayout = new QVBoxLayout();
+    rightLayout->addWidget(chartView, 3);
+    heatmap = new HeatmapWidget();
+    heatmap->hide(); // shown once a grid has been computed
+    rightLayout->addWidget(heatmap, 2);
+    mainLayout->addLayout(rightLayout, 1);
 
     connect(calcButton, &QPushButton::clicked, this, &AmortizationCalc::calculate);
 
+    // Live mode: edits restart a short debounce, then the schedule is
+    // computed on a worker and only a finished, current result is published
+    liveTimer = new QTimer(this);
+    liveTimer->setSingleShot(true);
+    liveTimer->setInterval(40);
+    connect(liveTimer, &QTimer::timeout, this, &AmortizationCalc::startLiveUpdate);
+    liveWatcher = new QFutureWatcher<std::shared_ptr<LiveResult>>(this);
+    connect(liveWatcher, &QFutureWatcher<std::shared_ptr<LiveResult>>::finished, this,
+            &AmortizationCalc::liveUpdateFinished);
+    connect(liveBox, &QCheckBox::toggled, this, [this](bool on) {
+        if (on)
+            scheduleLiveUpdate();
+    });
+    for (QLineEdit *edit : {principalEdit, rateEdit, termEdit})
+        connect(edit, &QLineEdit::textEdited, this, &AmortizationCalc::scheduleLiveUpdate);
+    connect(termTypeBox, &QComboBox::currentIndexChanged, this, &AmortizationCalc::scheduleLiveUpdate);
+    connect(arithmeticBox, &QComboBox::currentIndexChanged, this, &AmortizationCalc::scheduleLiveUpdate);
+
+    connect(rateSlider, &QSlider::valueChanged, this, [this](int value) {
+        rateEdit->setText(QString::number(value / 100.0, 'f', 2));
+        scheduleLiveUpdate();
+    });
+    connect(rateEdit, &QLineEdit::textChanged, this, [this](const QString &text) {
+        QSignalBlocker blocker(rateSlider);
+        rateSlider->setValue(qRound(text.toDouble() * 100));
+    });
+
     connect(termTypeBox, &QComboBox::currentTextChanged, this, [this](const QString &text) {
         termLabel->setText(QString("Term (%1):").arg(text));
     });
@@ -143,6 +258,155 @@ AmortizationCalc::AmortizationCalc(QWidget *parent) : QWidget(parent) {
 
     connect(exportButton, &QPushButton::clicked, this, &AmortizationCalc::exportCsv);
 
+#ifdef AMORTIZATION_PHASE_TIMING
+    // Per-phase timing; AMORTIZATION_PHASE_TIMING=1 in the environment turns it on at startup
+    auto *timingLayout = new QHBoxLayout();
+    timingBox = new QCheckBox("Show Phase Timing");
+    traceButton = new QPushButton("Save Trace...");
+    timingLayout->addWidget(timingBox);
+    timingLayout->addWidget(traceButton);
+    leftLayout->addLayout(timingLayout);
+    connect(timingBox, &QCheckBox::toggled, this, &AmortizationCalc::setPhaseTiming);
+    connect(traceButton, &QPushButton::clicked, this, &AmortizationCalc::saveTrace);
+#endif
+
+    auto *fileButtonsLayout = new QHBoxLayout();
+    saveButton = new QPushButton("Save Schedule...");
+    openButton = new QPushButton("Open Schedule...");
+    portfolioButton = new QPushButton("Load Portfolio...");
+    fileButtonsLayout->addWidget(saveButton);
+    fileButtonsLayout->addWidget(openButton);
+    fileButtonsLayout->addWidget(portfolioButton);
+    leftLayout->addLayout(fileButtonsLayout);
+
+    // Solvers and sensitivity grid, built on repeated schedule evaluations
+    auto *solverForm = new QFormLayout();
+    targetMonthEdit = new QLineEdit();
+    targetMonthEdit->setValidator(new QIntValidator(1, 12000, this));
+    solveExtraButton = new QPushButton("Solve Extra Payment");
+    auto *targetMonthLayout = new QHBoxLayout();
+    targetMonthLayout->addWidget(targetMonthEdit);
+    targetMonthLayout->addWidget(solveExtraButton);
+    solverForm->addRow("Pay Off By Month:", targetMonthLayout);
+
+    targetInterestEdit = new QLineEdit();
+    targetInterestEdit->setValidator(new QDoubleValidator(0, 1e12, 2, this));
+    solveRateButton = new QPushButton("Solve Break-Even Rate");
+    auto *targetInterestLayout = new QHBoxLayout();
+    targetInterestLayout->addWidget(targetInterestEdit);
+    targetInterestLayout->addWidget(solveRateButton);
+    solverForm->addRow("Target Total Interest ($):", targetInterestLayout);
+
+    gridAxisBox = new QComboBox();
+    gridAxisBox->addItem("Rate x Term");
+    gridAxisBox->addItem("Rate x Extra Payment");
+    gridButton = new QPushButton("Compute Grid");
+    auto *gridLayout = new QHBoxLayout();
+    gridLayout->addWidget(gridAxisBox);
+    gridLayout->addWidget(gridButton);
+    solverForm->addRow("Sensitivity Grid:", gridLayout);
+    leftLayout->addLayout(solverForm);
+
+    solverLabel = new QLabel();
+    leftLayout->addWidget(solverLabel);
+
+    connect(solveExtraButton, &QPushButton::clicked, this, &AmortizationCalc::solveExtraPayment);
+    connect(solveRateButton, &QPushButton::clicked, this, &AmortizationCalc::solveBreakEvenRate);
+    connect(gridButton, &QPushButton::clicked, this, &AmortizationCalc::computeGrid);
+
+    // Adjustable-rate simulation: percentile bands over many rate paths
+    auto *simulationForm = new QFormLayout();
+    fixedMonthsEdit = new QLineEdit("60");
+    fixedMonthsEdit->setValidator(new QIntValidator(0, 1200, this));
+    resetMonthsEdit = new QLineEdit("12");
+    resetMonthsEdit->setValidator(new QIntValidator(1, 1200, this));
+    auto *resetLayout = new QHBoxLayout();
+    resetLayout->addWidget(fixedMonthsEdit);
+    resetLayout->addWidget(new QLabel("then every"));
+    resetLayout->addWidget(resetMonthsEdit);
+    simulationForm->addRow("ARM Fixed / Reset (months):", resetLayout);
+
+    marginEdit = new QLineEdit("2.75");
+    marginEdit->setValidator(new QDoubleValidator(0, 20, 4, this));
+    volatilityEdit = new QLineEdit("1.0");
+    volatilityEdit->setValidator(new QDoubleValidator(0, 20, 4, this));
+    auto *modelLayout = new QHBoxLayout();
+    modelLayout->addWidget(marginEdit);
+    modelLayout->addWidget(new QLabel("volatility"));
+    modelLayout->addWidget(volatilityEdit);
+    simulationForm->addRow("Margin / Index Volatility (%):", modelLayout);
+
+    pathsEdit = new QLineEdit("100000");
+    pathsEdit->setValidator(new QIntValidator(1, 100000000, this));
+    simulateButton = new QPushButton("Simulate ARM");
+    auto *pathsLayout = new QHBoxLayout();
+    pathsLayout->addWidget(pathsEdit);
+    pathsLayout->addWidget(simulateButton);
+    simulationForm->addRow("Rate Paths:", pathsLayout);
+    leftLayout->addLayout(simulationForm);
+
+    connect(simulateButton, &QPushButton::clicked, this, &AmortizationCalc::simulateRates);
+
+    // Saved scenarios: double-click to switch, check to overlay on the chart
+    scenarioList = new QListWidget();
+    scenarioList->setMaximumHeight(120);
+    leftLayout->addWidget(scenarioList);
+    auto *scenarioButtonsLayout = new QHBoxLayout();
+    saveScenarioButton = new QPushButton("Save Scenario");
+    removeScenarioButton = new QPushButton("Remove Scenario");
+    exportScenariosButton = new QPushButton("Export Scenarios");
+    cacheBudgetBox = new QSpinBox();
+    cacheBudgetBox->setRange(0, 4096);
+    cacheBudgetBox->setValue(int(scenarioCache.byteBudget() >> 20));
+    cacheBudgetBox->setSuffix(" MB cache");
+    scenarioButtonsLayout->addWidget(saveScenarioButton);
+    scenarioButtonsLayout->addWidget(removeScenarioButton);
+    scenarioButtonsLayout->addWidget(exportScenariosButton);
+    scenarioButtonsLayout->addWidget(cacheBudgetBox);
+    leftLayout->addLayout(scenarioButtonsLayout);
+    cacheLabel = new QLabel();
+    leftLayout->addWidget(cacheLabel);
+    updateCacheLabel();
+
+    connect(saveScenarioButton, &QPushButton::clicked, this, &AmortizationCalc::saveScenario);
+    connect(removeScenarioButton, &QPushButton::clicked, this, &AmortizationCalc::removeScenario);
+    connect(exportScenariosButton, &QPushButton::clicked, this, &AmortizationCalc::exportScenarios);
+    connect(scenarioList, &QListWidget::itemActivated, this, &AmortizationCalc::switchScenario);
+    connect(scenarioList, &QListWidget::itemChanged, this, &AmortizationCalc::refreshOverlays);
+    connect(cacheBudgetBox, &QSpinBox::valueChanged, this, [this](int megabytes) {
+        scenarioCache.setByteBudget(std::size_t(megabytes) << 20);
+        updateCacheLabel();
+    });
+
+    computePool = std::make_unique<ThreadPool>();
+    gridWatcher = new QFutureWatcher<SensitivityGrid>(this);
+    connect(gridWatcher, &QFutureWatcher<SensitivityGrid>::finished, this, &AmortizationCalc::gridFinished);
+    simulationWatcher = new QFutureWatcher<SimulationResult>(this);
+    connect(simulationWatcher, &QFutureWatcher<SimulationResult>::progressValueChanged, this, [this](int value) {
+        solverLabel->setText(QString("Simulating rate paths... %1%").arg(value));
+    });
+    connect(simulationWatcher, &QFutureWatcher<SimulationResult>::finished, this,
+            &AmortizationCalc::simulationFinished);
+
+    connect(saveButton, &QPushButton::clicked, this, &AmortizationCalc::saveSchedule);
+    connect(openButton, &QPushButton::clicked, this, &AmortizationCalc::openSchedule);
+    connect(portfolioButton, &QPushButton::clicked, this, &AmortizationCalc::loadPortfolio);
+
+    portfolioWatcher = new QFutureWatcher<PortfolioResult>(this);
+    connect(portfolioWatcher, &QFutureWatcher<PortfolioResult>::progressValueChanged, this, [this](int value) {
+        solverLabel->setText(QString("Aggregating portfolio... %1%").arg(value));
+    });
+    connect(portfolioWatcher, &QFutureWatcher<PortfolioResult>::finished, this,
+            &AmortizationCalc::portfolioFinished);
+
+    // Exports run on a worker thread and report progress back here
+    exportWatcher = new QFutureWatcher<int>(this);
+    connect(exportWatcher, &QFutureWatcher<int>::progressValueChanged, this, [this](int value) {
+        if (exportProgress)
+            exportProgress->setValue(value);
+    });
+    connect(exportWatcher, &QFutureWatcher<int>::finished, this, &AmortizationCalc::exportFinished);
+
     tooltipTimer = new QTimer(this);
     tooltipTimer->setInterval(200); // refresh every 200ms
     connect(tooltipTimer, &QTimer::timeout, this, [this]() {
@@ -180,253 +444,1058 @@ AmortizationCalc::AmortizationCalc(QWidget *parent) : QWidget(parent) {
     chartView->viewport()->setMouseTracking(true);
     chartView->viewport()->installEventFilter(this);
 
-    connect(table, &QTableWidget::cellChanged, this, [this](int row, int col) {
-        // Only recalculate if the "One-Time Payment" column (index 5) is edited
-        if (col == 5) {
-            this->calculate();
+    phaseOverlay = new PhaseOverlay(chartView);
+    phaseOverlay->hide();
+#ifdef AMORTIZATION_PHASE_TIMING
+    if (qEnvironmentVariableIntValue("AMORTIZATION_PHASE_TIMING") != 0)
+        timingBox->setChecked(true);
+#endif
+
+    // The hover index is rebuilt lazily once the points or the geometry change
+    auto invalidateHover = [this]() { hoverIndex.invalidate(); };
+    for (QLineSeries *series : {principalSeries, interestSeries, totalSeries}) {
+        connect(series, &QXYSeries::pointsReplaced, this, invalidateHover);
+        connect(series, &QXYSeries::pointReplaced, this, invalidateHover);
+    }
+    connect(chart, &QChart::plotAreaChanged, this, invalidateHover);
+    connect(axisX, &QValueAxis::rangeChanged, this, invalidateHover);
+    connect(axisY, &QValueAxis::rangeChanged, this, invalidateHover);
+
+    // Only the "One-Time Payment" column is editable. A cell shows the month's
+    // total, so the one-time part is whatever the recurring payments leave;
+    // less than the recurring payments is refused, as rules cannot be skipped.
+    connect(scheduleModel, &ScheduleModel::prepaymentEdited, this, [this](int row, double amount) {
+        int month = row + 1;
+        double recurring = prepaymentPlan.recurringIn(month);
+        if (amount < recurring) {
+            solverLabel->setText(QString("Month %1 has $%2 of recurring payments; enter at least that, "
+                                         "or change the rule.")
+                                     .arg(month)
+                                     .arg(QLocale::system().toString(recurring, 'f', 2)));
+            return;
         }
-    });
+        prepaymentPlan.setOneTime(month, amount - recurring);
+        savePrepayments();
+        prepaymentChanged(row);
+    }, Qt::QueuedConnection);
+
+    restorePrepayments();
 }
 
-void AmortizationCalc::calculate() {
-    table->blockSignals(true);
+AmortizationCalc::~AmortizationCalc() {
+    // Background work borrows computePool; let it finish before the pool goes
+    simulationWatcher->cancel();
+    simulationWatcher->waitForFinished();
+    portfolioWatcher->cancel();
+    portfolioWatcher->waitForFinished();
+    gridWatcher->waitForFinished();
+    // An export still writing would leave a partial file; cancelling removes it
+    exportWatcher->cancel();
+    exportWatcher->waitForFinished();
+    if (liveCancel)
+        liveCancel->store(true, std::memory_order_relaxed);
+    liveWatcher->waitForFinished();
+}
+
+LoanTerms AmortizationCalc::readTerms() const {
+    PHASE_SCOPE("calculate/inputs");
     // Remove commas from input before conversion
     QString principalStr = principalEdit->text().remove(',');
     QString rateStr = rateEdit->text().remove(',');
     QString termStr = termEdit->text().remove(',');
 
-    double principal = principalStr.toDouble();
-    double annualRate = rateStr.toDouble();
+    bool useYears = (termTypeBox->currentText() == "Years");
+
+    LoanTerms terms;
+    terms.principal = principalStr.toDouble();
+    terms.annualRate = rateStr.toDouble();
+    terms.months = termToMonths(termStr.toDouble(), useYears ? TermUnit::Years : TermUnit::Months);
+    return terms;
+}
 
-    double termValue = termStr.toDouble();
-    int months = 0;
+void AmortizationCalc::calculate() {
+    PHASE_SCOPE("calculate");
+    ++liveGeneration; // anything still computing is older than this
+    LoanTerms terms = readTerms();
     bool useYears = (termTypeBox->currentText() == "Years");
-    if (useYears) {
-        months = static_cast<int>(termValue * 12);
-    } else {
-        months = static_cast<int>(termValue);
-    }
 
-    if (principal <= 0 || annualRate <= 0 || months <= 0) {
-        resultLabel->setText("Please enter valid values.");
-        table->setRowCount(0);
+    if (!isValid(terms, selectedArithmetic())) {
+        resultLabel->setText(isValid(terms) ? "Principal or rate too large for whole-cent arithmetic."
+                                            : "Please enter valid values.");
+        currentTerms = LoanTerms();
+        showingPortfolio = false;
+        scheduleModel->setPrepaymentsEditable(true);
+        amortize(LoanTerms(), schedule); // empties it
+        scheduleModel->reload();
         totalInterestLabel->clear();
-        table->blockSignals(false);
         return;
     }
 
-    double monthlyRate = annualRate / 12.0 / 100.0;
-    double monthlyPayment = (principal * monthlyRate) / (1 - std::pow(1 + monthlyRate, -months));
+    currentTerms = terms;
+    showingPortfolio = false;
+    currentArithmetic = selectedArithmetic();
+    chartInYears = useYears;
+    clearSimulationBands(); // they belong to the previous terms
+
+    ScenarioKey key = ScenarioKey::make(terms, useYears, currentArithmetic, prepaymentPlan.events(terms.months));
+    if (std::shared_ptr<const Schedule> cached = scenarioCache.find(key)) {
+        PHASE_SCOPE("calculate/cacheHit");
+        schedule = *cached;
+    } else {
+        PHASE_SCOPE("calculate/amortize");
+        amortize(terms, prepaymentPlan, schedule, currentArithmetic);
+        scenarioCache.insert(key, std::make_shared<const Schedule>(schedule));
+    }
+    updateCacheLabel();
+    publishSchedule();
+} // <-- This closes AmortizationCalc::calculate()
 
-    table->setRowCount(months);
+void AmortizationCalc::scheduleLiveUpdate() {
+    if (!liveBox->isChecked())
+        return;
+    ++liveGeneration;
+    if (liveCancel)
+        liveCancel->store(true, std::memory_order_relaxed);
+    liveTimer->start(); // restarts the debounce
+}
 
-    double balance = principal;
-    double totalInterest = 0.0;
+void AmortizationCalc::startLiveUpdate() {
+    if (liveWatcher->isRunning()) {
+        livePending = true; // cancelled above; start again once it stops
+        return;
+    }
 
-    int i = 0;
-    for (; i < months; ++i) {
-        double interest = balance * monthlyRate;
-        double principalPaid = monthlyPayment - interest;
+    auto job = std::make_shared<LiveResult>();
+    job->generation = liveGeneration;
+    job->terms = readTerms();
+    job->inYears = (termTypeBox->currentText() == "Years");
+    job->arithmetic = selectedArithmetic();
+    if (!isValid(job->terms, job->arithmetic)) {
+        resultLabel->setText(isValid(job->terms) ? "Principal or rate too large for whole-cent arithmetic."
+                                                 : "Please enter valid values.");
+        return;
+    }
+    job->plan = prepaymentPlan;
+    job->key = ScenarioKey::make(job->terms, job->inYears, job->arithmetic, prepaymentPlan.events(job->terms.months));
+
+    // A scenario seen before needs no worker at all
+    if (std::shared_ptr<const Schedule> cached = scenarioCache.find(job->key)) {
+        currentTerms = job->terms;
+        showingPortfolio = false;
+        currentArithmetic = job->arithmetic;
+        chartInYears = job->inYears;
+        clearSimulationBands();
+        schedule = *cached;
+        updateCacheLabel();
+        publishSchedule();
+        return;
+    }
 
-        // Read one-time payment from table if present
-        double oneTimePayment = 0.0;
-        QTableWidgetItem *otpItem = table->item(i, 5);
-        if (otpItem) {
-            // Remove commas before conversion
-            oneTimePayment = otpItem->text().remove(',').toDouble();
-        }
+    liveCancel = std::make_shared<std::atomic<bool>>(false);
+    liveWatcher->setFuture(QtConcurrent::run([job, cancelled = liveCancel]() {
+        PHASE_SCOPE("live/amortize");
+        job->complete = amortize(job->terms, job->plan, job->schedule, job->arithmetic, *cancelled);
+        return job;
+    }));
+}
 
-        if (i == months - 1) { // last payment adjustment
-            principalPaid = balance;
-            monthlyPayment = principalPaid + interest;
-        }
+void AmortizationCalc::liveUpdateFinished() {
+    std::shared_ptr<LiveResult> job = liveWatcher->result();
+    if (livePending) {
+        livePending = false;
+        startLiveUpdate();
+    }
+    if (!job->complete || job->generation != liveGeneration)
+        return; // cancelled or superseded
+
+    PHASE_SCOPE("live/publish");
+    currentTerms = job->terms;
+    showingPortfolio = false;
+    currentArithmetic = job->arithmetic;
+    chartInYears = job->inYears;
+    clearSimulationBands();
+    schedule = std::move(job->schedule); // the model keeps pointing at schedule
+    scenarioCache.insert(job->key, std::make_shared<const Schedule>(schedule));
+    updateCacheLabel();
+    publishSchedule();
+}
 
-        balance -= principalPaid;
-        balance -= oneTimePayment; // <-- Subtract one-time payment
-
-        if (balance < 0) balance = 0;
-
-        totalInterest += interest;
-
-        table->setItem(i, 0, new QTableWidgetItem(QString::number(i + 1)));
-        table->setItem(i, 1, new QTableWidgetItem(QString::number(monthlyPayment, 'f', 2)));
-        table->setItem(i, 2, new QTableWidgetItem(QString::number(principalPaid, 'f', 2)));
-        table->setItem(i, 3, new QTableWidgetItem(QString::number(interest, 'f', 2)));
-        table->setItem(i, 4, new QTableWidgetItem(QString::number(std::max(0.0, balance), 'f', 2)));
-
-        // Make the one-time payment cell editable
-        QTableWidgetItem *otpEdit = new QTableWidgetItem();
-        otpEdit->setFlags(otpEdit->flags() | Qt::ItemIsEditable);
-        if (otpItem) otpEdit->setText(otpItem->text());
-        table->setItem(i, 5, otpEdit);
-
-        // Update chart series
-        principalSeries->append(i + 1, principalPaid);
-        interestSeries->append(i + 1, interest);
-        totalSeries->append(i + 1, principalPaid + interest);
-
-        if (balance <= 0) {
-            // Fill remaining rows with zeros if loan is paid off early
-            for (int j = i + 1; j < months; ++j) {
-                table->setItem(j, 0, new QTableWidgetItem(QString::number(j + 1)));
-                for (int k = 1; k < 5; ++k) { // Only columns 1-4 get zeros
-                    table->setItem(j, k, new QTableWidgetItem("0.00"));
-                }
-                // For the "One-Time Payment" column (index 5), leave blank but editable
-                QTableWidgetItem *otpEdit = new QTableWidgetItem();
-                otpEdit->setFlags(otpEdit->flags() | Qt::ItemIsEditable);
-                table->setItem(j, 5, otpEdit);
+void AmortizationCalc::publishSchedule() {
+    {
+        PHASE_SCOPE("calculate/table");
+        scheduleModel->setPrepaymentsEditable(!showingPortfolio);
+        scheduleModel->reload();
+    }
+    updateSummary();
+
+    // Update axis labels and ticks; the full range also resets any zoom
+    {
+        PHASE_SCOPE("calculate/axes");
+        const int months = schedule.periods;
+        updatingAxes = true;
+        QValueAxis *axisX = qobject_cast<QValueAxis *>(chartView->chart()->axisX());
+        if (axisX) {
+            if (chartInYears) {
+                axisX->setTitleText("Year");
+                axisX->setLabelFormat("%d");
+                int totalYears = (months + 11) / 12;
+                axisX->setRange(1, totalYears);
+                axisX->setTickInterval(10); // 10 years per tick
+            } else {
+                axisX->setTitleText("Month");
+                axisX->setLabelFormat("%d");
+                axisX->setRange(1, months);
+                axisX->setTickInterval(10); // 10 months per tick
             }
-            break;
         }
+        updatingAxes = false;
+    }
+
+    updateChart(0);
+    refreshOverlays(); // their x values follow the current unit
+}
+
+void AmortizationCalc::prepaymentChanged(int row) {
+    PHASE_SCOPE("prepayment");
+    ++liveGeneration; // a live result in flight has the old payments
+    // Inputs edited since the last calculation invalidate every row
+    if (!isValid(currentTerms, currentArithmetic) || readTerms() != currentTerms
+        || currentArithmetic != selectedArithmetic() || chartInYears != (termTypeBox->currentText() == "Years")) {
+        calculate();
+        return;
+    }
+
+    // Rows before the edit are unaffected; resume from their checkpoint
+    {
+        PHASE_SCOPE("prepayment/amortizeFrom");
+        amortizeFrom(currentTerms, prepaymentPlan, schedule, row, currentArithmetic);
     }
+    scheduleModel->rowsChanged(row, schedule.periods - 1);
+    updateSummary();
+    updateChart(row);
+}
 
+void AmortizationCalc::updateSummary() {
+    PHASE_SCOPE("calculate/summary");
     QLocale locale = QLocale::system();
 
     totalInterestLabel->setText(
         QString("Total Interest Paid: $%1")
-            .arg(locale.toString(totalInterest, 'f', 2))
+            .arg(locale.toString(schedule.totalInterest, 'f', 2))
     );
-    double paidYears = (i + 1) / 12.0;
+    double paidYears = schedule.paidOffPeriod / 12.0;
     monthsPaidLabel->setText(
         QString("Total Months Until Paid Off: %1 (%2 years)")
-            .arg(i + 1)
+            .arg(schedule.paidOffPeriod)
             .arg(QString::number(paidYears, 'f', 2))
     );
     totalPaidLabel->setText(
         QString("Total Principal + Interest Paid: $%1")
-            .arg(locale.toString(principal + totalInterest, 'f', 2))
+            .arg(locale.toString((showingPortfolio ? portfolioPrincipal : currentTerms.principal)
+                                     + schedule.totalInterest, 'f', 2))
     );
     resultLabel->setText(
         QString("Monthly Payment: $%1")
-            .arg(locale.toString(monthlyPayment, 'f', 2))
+            .arg(locale.toString(schedule.monthlyPayment, 'f', 2))
     );
+}
 
-    principalSeries->clear();
-    interestSeries->clear();
-    totalSeries->clear();
-
-    double runningPrincipal = 0.0;
-    double runningInterest = 0.0;
-    if (useYears) {
-        int totalYears = (months + 11) / 12;
-        for (int year = 1; year <= totalYears; ++year) {
-            int lastMonthOfYear = std::min(year * 12, months);
-            // Accumulate up to the end of this year (cumulative)
-            for (int row = (year - 1) * 12; row < lastMonthOfYear; ++row) {
-                double p = table->item(row, 2) ? table->item(row, 2)->text().toDouble() : 0.0;
-                double in = table->item(row, 3) ? table->item(row, 3)->text().toDouble() : 0.0;
-                runningPrincipal += p;
-                runningInterest += in;
-            }
-            principalSeries->append(year, runningPrincipal);
-            interestSeries->append(year, runningInterest);
-            totalSeries->append(year, runningPrincipal + runningInterest);
-        }
-    } else {
-        runningPrincipal = 0.0;
-        runningInterest = 0.0;
-        for (int row = 0; row < months; ++row) {
-            double p = table->item(row, 2) ? table->item(row, 2)->text().toDouble() : 0.0;
-            double in = table->item(row, 3) ? table->item(row, 3)->text().toDouble() : 0.0;
-            runningPrincipal += p;
-            runningInterest += in;
-            principalSeries->append(row + 1, runningPrincipal);
-            interestSeries->append(row + 1, runningInterest);
-            totalSeries->append(row + 1, runningPrincipal + runningInterest);
-        }
+void AmortizationCalc::updateChart(int firstRow) {
+    PHASE_SCOPE("calculate/series");
+    // One point per month, or per year with the cumulative total at year end
+    const int months = schedule.periods;
+    const int step = chartInYears ? 12 : 1;
+    const int count = (months + step - 1) / step;
+    const int firstPoint = std::min(firstRow / step, count);
+
+    principalPoints.resize(count);
+    interestPoints.resize(count);
+    totalPoints.resize(count);
+    for (int p = firstPoint; p < count; ++p) {
+        int row = std::min((p + 1) * step, months) - 1;
+        double x = p + 1;
+        double cumPrincipal = schedule.cumulativePrincipal[row];
+        double cumInterest = schedule.cumulativeInterest[row];
+        principalPoints[p] = QPointF(x, cumPrincipal);
+        interestPoints[p] = QPointF(x, cumInterest);
+        totalPoints[p] = QPointF(x, cumPrincipal + cumInterest);
     }
 
-    // Update axis labels and ticks
-    QValueAxis *axisX = qobject_cast<QValueAxis *>(chartView->chart()->axisX());
-    if (axisX) {
-        if (useYears) {
-            axisX->setTitleText("Year");
-            axisX->setLabelFormat("%d");
-            int totalYears = (months + 11) / 12;
-            axisX->setRange(1, totalYears);
-            axisX->setTickInterval(10); // 10 years per tick
-        } else {
-            axisX->setTitleText("Month");
-            axisX->setLabelFormat("%d");
-            axisX->setRange(1, months);
-            axisX->setTickInterval(10); // 10 months per tick
+    // When every point is on screen, patch a short changed tail point by
+    // point; otherwise rebuild the decimated view in one replace() per series
+    const int changed = count - firstPoint;
+    const int patchLimit = 64;
+    if (firstRow > 0 && principalSeries->count() == count && changed <= patchLimit) {
+        for (int p = firstPoint; p < count; ++p) {
+            principalSeries->replace(p, principalPoints[p]);
+            interestSeries->replace(p, interestPoints[p]);
+            totalSeries->replace(p, totalPoints[p]);
         }
+    } else {
+        refreshSeries();
     }
+
     QValueAxis *axisY = qobject_cast<QValueAxis *>(chartView->chart()->axisY());
     if (axisY) {
-        axisY->setRange(0, runningPrincipal + runningInterest);
+        axisY->setRange(0, std::max(count > 0 ? totalPoints[count - 1].y() : 0.0, overlayMaxY));
     }
-    table->blockSignals(false);
-} // <-- This closes AmortizationCalc::calculate()
+}
+
+void AmortizationCalc::refreshSeries() {
+    PHASE_SCOPE("calculate/series/decimate");
+    // Cap the drawn points at the plot width, sampling only the visible range
+    double xMin = -std::numeric_limits<double>::infinity();
+    double xMax = std::numeric_limits<double>::infinity();
+    QValueAxis *axisX = qobject_cast<QValueAxis *>(chartView->chart()->axisX());
+    if (axisX) {
+        xMin = axisX->min();
+        xMax = axisX->max();
+    }
+    const int maxPoints = std::max(100, int(chartView->chart()->plotArea().width()));
+
+    principalSeries->replace(decimateMinMax(principalPoints, xMin, xMax, maxPoints));
+    interestSeries->replace(decimateMinMax(interestPoints, xMin, xMax, maxPoints));
+    totalSeries->replace(decimateMinMax(totalPoints, xMin, xMax, maxPoints));
+}
 
 void AmortizationCalc::exportCsv() {
+    if (exportWatcher->isRunning())
+        return;
+
     QString fileName = QFileDialog::getSaveFileName(this, "Export Table as CSV", "", "CSV Files (*.csv)");
     if (fileName.isEmpty())
         return;
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        resultLabel->setText("Failed to open file for writing.");
+    // Export a snapshot so edits made while it runs cannot race with the writer
+    std::shared_ptr<const Schedule> snapshot;
+    {
+        PHASE_SCOPE("export/snapshot");
+        snapshot = std::make_shared<const Schedule>(schedule);
+    }
+    startExport(fileName, {snapshot});
+}
+
+void AmortizationCalc::exportScenarios() {
+    if (exportWatcher->isRunning())
+        return;
+    if (scenarios.empty()) {
+        resultLabel->setText("Save a scenario before exporting scenarios.");
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Scenarios as CSV", "", "CSV Files (*.csv)");
+    if (fileName.isEmpty())
+        return;
+
+    // Cached schedules are immutable, so sharing them is already a snapshot;
+    // the Loan column numbers them in list order
+    std::vector<std::shared_ptr<const Schedule>> snapshots;
+    snapshots.reserve(scenarios.size());
+    {
+        PHASE_SCOPE("export/snapshot");
+        for (const SavedScenario &scenario : scenarios)
+            snapshots.push_back(cachedSchedule(scenario.key));
+    }
+    updateCacheLabel();
+    startExport(fileName, std::move(snapshots));
+}
+
+void AmortizationCalc::startExport(const QString &fileName, std::vector<std::shared_ptr<const Schedule>> schedules) {
+    std::string path = QFile::encodeName(fileName).toStdString();
+    exportFileName = fileName;
+
+    exportProgress = new QProgressDialog("Exporting schedule...", "Cancel", 0, 1000, this);
+    exportProgress->setMinimumDuration(500); // only shows up for slow exports
+    connect(exportProgress, &QProgressDialog::canceled, exportWatcher, &QFutureWatcher<int>::cancel);
+    exportButton->setEnabled(false);
+    exportScenariosButton->setEnabled(false);
+
+    exportWatcher->setFuture(QtConcurrent::run([schedules = std::move(schedules), path](QPromise<int> &promise) {
+        PHASE_SCOPE("export/write");
+        promise.setProgressRange(0, 1000);
+        std::vector<const Schedule *> pointers;
+        for (const std::shared_ptr<const Schedule> &schedule : schedules)
+            pointers.push_back(schedule.get());
+        ExportStatus status = exportSchedulesCsv(path, pointers, [&promise](long long done, long long total) {
+            promise.setProgressValue(total > 0 ? int(done * 1000 / total) : 1000);
+            return !promise.isCanceled();
+        });
+        promise.addResult(int(status));
+    }));
+}
+
+void AmortizationCalc::saveSchedule() {
+    if (!isValid(currentTerms)) {
+        resultLabel->setText("Calculate a schedule before saving.");
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Schedule", "", "Schedule Files (*.amsched)");
+    if (fileName.isEmpty())
+        return;
+
+    ScheduleFileWriter writer;
+    bool ok = writer.open(QFile::encodeName(fileName).toStdString(), 1, schedule.periods)
+        && writer.append(currentTerms, schedule);
+    ok = writer.close() && ok;
+    resultLabel->setText(ok ? "Saved schedule to: " + fileName : QString("Failed to save schedule."));
+}
+
+void AmortizationCalc::openSchedule() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Open Schedule", "", "Schedule Files (*.amsched);;All Files (*)");
+    if (fileName.isEmpty())
+        return;
+
+    ScheduleFileReader reader;
+    if (!reader.open(QFile::encodeName(fileName).toStdString()) || reader.loanCount() == 0) {
+        resultLabel->setText("Not a schedule file: " + fileName);
+        return;
+    }
+
+    // Files written by batch runs can hold many loans; pick one
+    int loanIndex = 0;
+    if (reader.loanCount() > 1) {
+        bool ok = false;
+        int maxLoan = int(std::min<std::uint64_t>(reader.loanCount(), std::numeric_limits<int>::max()));
+        loanIndex = QInputDialog::getInt(this, "Open Schedule",
+                                         QString("Loan to show (1-%1):").arg(maxLoan), 1, 1, maxLoan, 1, &ok) - 1;
+        if (!ok)
+            return;
+    }
+    ScheduleView view = reader.loan(loanIndex);
+    if (!isValid(view.terms) || view.periods != view.terms.months) {
+        resultLabel->setText("Schedule file is damaged: " + fileName);
+        return;
+    }
+
+    // Show the stored rows as-is; nothing is recomputed
+    principalEdit->setText(QString::number(view.terms.principal, 'f', 2));
+    rateEdit->setText(QString::number(view.terms.annualRate));
+    termEdit->setText(QString::number(view.terms.months));
+    termTypeBox->setCurrentText("Months");
+    ++liveGeneration; // live results and simulations in flight belong to the old schedule
+    currentTerms = view.terms;
+    showingPortfolio = false;
+    currentArithmetic = selectedArithmetic(); // used for later one-time payment edits
+    chartInYears = false;
+    view.copyTo(schedule);
+
+    // The file stores each month's total; keep them as one-time payments
+    std::vector<Prepayment> payments;
+    for (int i = 0; i < schedule.periods; ++i) {
+        if (schedule.prepayment[i] != 0.0)
+            payments.push_back({i + 1, schedule.prepayment[i]});
+    }
+    prepaymentPlan.clear();
+    prepaymentPlan.addOneTime(payments);
+    savePrepayments();
+    refreshRuleList();
+    publishSchedule();
+}
+
+void AmortizationCalc::loadPortfolio() {
+    if (portfolioWatcher->isRunning())
+        return;
+    QString fileName = QFileDialog::getOpenFileName(this, "Load Portfolio", "", "Loan Files (*.csv *.txt);;All Files (*)");
+    if (fileName.isEmpty())
+        return;
+
+    const std::uint64_t fileSize = std::max<qint64>(QFileInfo(fileName).size(), 1);
+    std::string path = QFile::encodeName(fileName).toStdString();
+    portfolioButton->setEnabled(false);
+    solverLabel->setText("Aggregating portfolio...");
+    portfolioTimer.start();
+    ThreadPool *pool = computePool.get();
+    portfolioWatcher->setFuture(QtConcurrent::run([path, fileSize, pool](QPromise<PortfolioResult> &promise) {
+        promise.setProgressRange(0, 100);
+        PortfolioResult result;
+        bool done = aggregatePortfolio(path, *pool, result, [&promise, fileSize](std::uint64_t bytesRead) {
+            promise.setProgressValue(int(std::min<std::uint64_t>(bytesRead * 100 / fileSize, 100)));
+            return !promise.isCanceled();
+        });
+        if (done)
+            promise.addResult(std::move(result));
+    }));
+}
+
+void AmortizationCalc::portfolioFinished() {
+    portfolioButton->setEnabled(true);
+    if (portfolioWatcher->future().resultCount() == 0) {
+        solverLabel->setText("Failed to read the portfolio file.");
+        return;
+    }
+    PortfolioResult result = portfolioWatcher->future().takeResult();
+    if (result.loans == 0) {
+        solverLabel->setText("The portfolio file has no valid loans.");
         return;
     }
 
-    QTextStream out(&file);
+    // The aggregate has no terms of its own; inputs edited later replace it
+    ++liveGeneration;
+    currentTerms = LoanTerms();
+    showingPortfolio = true;
+    portfolioPrincipal = result.principal;
+    chartInYears = false;
+    clearSimulationBands();
+    schedule = std::move(result.aggregate);
+    publishSchedule();
+    solverLabel->setText(
+        QString("Aggregated %1 loans (%2 invalid) in %3 ms.")
+            .arg(QLocale::system().toString(result.loans))
+            .arg(QLocale::system().toString(result.skipped))
+            .arg(portfolioTimer.elapsed())
+    );
+}
+
+Arithmetic AmortizationCalc::selectedArithmetic() const {
+    return static_cast<Arithmetic>(arithmeticBox->currentIndex());
+}
 
-    // Write headers
-    QStringList headers;
-    for (int col = 0; col < table->columnCount(); ++col)
-        headers << table->horizontalHeaderItem(col)->text();
-    out << headers.join(",") << "\n";
+LoanRecord AmortizationCalc::currentLoan() const {
+    LoanRecord loan;
+    loan.terms = readTerms();
+    loan.prepayments = prepaymentPlan.events(loan.terms.months);
+    return loan;
+}
 
-    // Write data
-    for (int row = 0; row < table->rowCount(); ++row) {
-        QStringList rowData;
-        for (int col = 0; col < table->columnCount(); ++col) {
-            QTableWidgetItem *item = table->item(row, col);
-            rowData << (item ? item->text() : "");
+void AmortizationCalc::solveExtraPayment() {
+    LoanRecord loan = currentLoan();
+    int targetMonth = targetMonthEdit->text().toInt();
+    if (!isValid(loan.terms) || targetMonth < 1) {
+        solverLabel->setText("Enter a valid loan and target month.");
+        return;
+    }
+
+    double extra = 0.0;
+    if (!::solveExtraPayment(loan, targetMonth, extra)) {
+        solverLabel->setText("No extra payment can pay the loan off by then.");
+        return;
+    }
+    solverLabel->setText(
+        QString("Extra $%1/month pays off by month %2.")
+            .arg(QLocale::system().toString(extra, 'f', 2))
+            .arg(targetMonth)
+    );
+}
+
+void AmortizationCalc::solveBreakEvenRate() {
+    LoanRecord loan = currentLoan();
+    double targetInterest = targetInterestEdit->text().remove(',').toDouble();
+    if (!isValid(loan.terms) || targetInterest <= 0) {
+        solverLabel->setText("Enter a valid loan and target interest.");
+        return;
+    }
+
+    double rate = 0.0;
+    if (!solveRateForInterest(loan, targetInterest, rate)) {
+        solverLabel->setText("No rate up to 100% gives that total interest.");
+        return;
+    }
+    solverLabel->setText(
+        QString("Break-even rate: %1% for $%2 total interest.")
+            .arg(rate, 0, 'f', 4)
+            .arg(QLocale::system().toString(targetInterest, 'f', 2))
+    );
+}
+
+void AmortizationCalc::computeGrid() {
+    if (gridWatcher->isRunning())
+        return;
+    LoanRecord loan = currentLoan();
+    if (!isValid(loan.terms)) {
+        solverLabel->setText("Enter a valid loan first.");
+        return;
+    }
+
+    // 200 x 200 cells: rates from half to one and a half times the current
+    // rate against 1-40 year terms or up to twice the monthly payment extra
+    const int size = 200;
+    SensitivityGrid grid;
+    grid.columnAxis = gridAxisBox->currentIndex() == 0 ? SensitivityGrid::Term : SensitivityGrid::ExtraPayment;
+    double rateLo = std::max(0.01, loan.terms.annualRate * 0.5);
+    double rateHi = std::max(rateLo + 0.01, loan.terms.annualRate * 1.5);
+    double maxExtra = 2.0 * levelPayment(loan.terms);
+    for (int i = 0; i < size; ++i) {
+        double f = double(i) / (size - 1);
+        grid.rates.push_back(rateLo + (rateHi - rateLo) * f);
+        if (grid.columnAxis == SensitivityGrid::Term)
+            grid.columns.push_back(std::round(12 + (480 - 12) * f));
+        else
+            grid.columns.push_back(maxExtra * f);
+    }
+
+    gridButton->setEnabled(false);
+    solverLabel->setText("Computing sensitivity grid...");
+    gridTimer.start();
+    ThreadPool *pool = computePool.get();
+    gridWatcher->setFuture(QtConcurrent::run([loan, grid, pool]() mutable {
+        evaluateGrid(loan, grid, *pool);
+        return grid;
+    }));
+}
+
+void AmortizationCalc::gridFinished() {
+    gridButton->setEnabled(true);
+    SensitivityGrid grid = gridWatcher->result();
+    heatmap->setGrid(grid);
+    heatmap->show();
+    solverLabel->setText(
+        QString("Evaluated %1 x %2 grid in %3 ms.")
+            .arg(grid.rowCount())
+            .arg(grid.columnCount())
+            .arg(gridTimer.elapsed())
+    );
+}
+
+void AmortizationCalc::simulateRates() {
+    if (simulationWatcher->isRunning())
+        return;
+    if (!isValid(currentTerms) || readTerms() != currentTerms
+        || chartInYears != (termTypeBox->currentText() == "Years"))
+        calculate();
+    if (!isValid(currentTerms))
+        return;
+
+    // Center the index so the first reset expects the current rate
+    ArmTerms arm;
+    arm.loan = currentTerms;
+    arm.fixedMonths = fixedMonthsEdit->text().toInt();
+    arm.resetMonths = resetMonthsEdit->text().toInt();
+    arm.margin = marginEdit->text().toDouble();
+    RateModel model;
+    model.initialIndex = std::max(0.0, currentTerms.annualRate - arm.margin);
+    model.longRunIndex = model.initialIndex;
+    model.volatility = volatilityEdit->text().toDouble();
+    SimulationOptions options;
+    options.paths = pathsEdit->text().toLongLong();
+    if (!isValid(arm) || options.paths < 1) {
+        solverLabel->setText("Enter a valid reset schedule and path count.");
+        return;
+    }
+
+    simulateButton->setEnabled(false);
+    solverLabel->setText("Simulating rate paths...");
+    simulationTerms = currentTerms;
+    simulationGeneration = liveGeneration;
+    simulationTimer.start();
+    ThreadPool *pool = computePool.get();
+    simulationWatcher->setFuture(QtConcurrent::run([arm, model, options, pool](QPromise<SimulationResult> &promise) {
+        promise.setProgressRange(0, 100);
+        SimulationResult result;
+        bool done = simulateArm(arm, model, options, *pool, result, [&promise](long long paths, long long total) {
+            promise.setProgressValue(int(paths * 100 / total));
+            return !promise.isCanceled();
+        });
+        if (done)
+            promise.addResult(std::move(result));
+    }));
+}
+
+void AmortizationCalc::simulationFinished() {
+    simulateButton->setEnabled(true);
+    if (simulationWatcher->future().resultCount() == 0) {
+        solverLabel->clear();
+        return;
+    }
+    SimulationResult result = simulationWatcher->result();
+    // Any recalculation or payment edit since the start bumps liveGeneration
+    if (currentTerms != simulationTerms || liveGeneration != simulationGeneration
+        || result.months() != schedule.periods) {
+        solverLabel->setText("Inputs changed during the simulation; run it again.");
+        return;
+    }
+    showSimulationBands(result);
+    solverLabel->setText(
+        QString("Simulated %1 rate paths in %2 ms.")
+            .arg(QLocale::system().toString(result.paths))
+            .arg(simulationTimer.elapsed())
+    );
+}
+
+void AmortizationCalc::showSimulationBands(const SimulationResult &result) {
+    QChart *chart = chartView->chart();
+    if (!balanceMedianSeries) {
+        // Balance bands share the amount axis; payments get their own scale
+        auto makeBand = [this](const QString &name, const QColor &color) {
+            auto *band = new QAreaSeries(new QLineSeries(this), new QLineSeries(this));
+            band->setName(name);
+            band->setColor(color);
+            band->setBorderColor(Qt::transparent);
+            return band;
+        };
+        balanceOuterBand = makeBand("Balance 5-95%", QColor(70, 130, 180, 50));
+        balanceInnerBand = makeBand("Balance 25-75%", QColor(70, 130, 180, 90));
+        balanceMedianSeries = new QLineSeries();
+        balanceMedianSeries->setName("Median Balance");
+        paymentBand = makeBand("Payment 5-95%", QColor(255, 140, 0, 60));
+        paymentMedianSeries = new QLineSeries();
+        paymentMedianSeries->setName("Median Payment");
+
+        paymentAxis = new QValueAxis;
+        paymentAxis->setTitleText("Payment ($)");
+        paymentAxis->setLabelFormat("%.0f");
+        chart->addAxis(paymentAxis, Qt::AlignRight);
+
+        for (QAbstractSeries *series : std::initializer_list<QAbstractSeries *>{
+                 balanceOuterBand, balanceInnerBand, balanceMedianSeries}) {
+            chart->addSeries(series);
+            chart->setAxisX(chart->axisX(), series);
+            chart->setAxisY(chart->axisY(), series);
+        }
+        for (QAbstractSeries *series : std::initializer_list<QAbstractSeries *>{paymentBand, paymentMedianSeries}) {
+            chart->addSeries(series);
+            series->attachAxis(chart->axisX());
+            series->attachAxis(paymentAxis);
         }
-        out << rowData.join(",") << "\n";
     }
-    file.close();
-    resultLabel->setText("Exported table to: " + fileName);
+
+    // Same x positions as the schedule lines: months, or year ends
+    const int months = result.months();
+    const int step = chartInYears ? 12 : 1;
+    const int count = (months + step - 1) / step;
+    QList<QPointF> balance5, balance25, balance50, balance75, balance95, payment5, payment50, payment95;
+    double maxPayment = 0.0;
+    for (int p = 0; p < count; ++p) {
+        int row = std::min((p + 1) * step, months) - 1;
+        double x = p + 1;
+        const QuantileSketch &balance = result.balance[row];
+        const QuantileSketch &payment = result.payment[row];
+        balance5.append(QPointF(x, balance.quantile(0.05)));
+        balance25.append(QPointF(x, balance.quantile(0.25)));
+        balance50.append(QPointF(x, balance.quantile(0.50)));
+        balance75.append(QPointF(x, balance.quantile(0.75)));
+        balance95.append(QPointF(x, balance.quantile(0.95)));
+        payment5.append(QPointF(x, payment.quantile(0.05)));
+        payment50.append(QPointF(x, payment.quantile(0.50)));
+        payment95.append(QPointF(x, payment.quantile(0.95)));
+        maxPayment = std::max(maxPayment, payment95.last().y());
+    }
+    balanceOuterBand->upperSeries()->replace(balance95);
+    balanceOuterBand->lowerSeries()->replace(balance5);
+    balanceInnerBand->upperSeries()->replace(balance75);
+    balanceInnerBand->lowerSeries()->replace(balance25);
+    balanceMedianSeries->replace(balance50);
+    paymentBand->upperSeries()->replace(payment95);
+    paymentBand->lowerSeries()->replace(payment5);
+    paymentMedianSeries->replace(payment50);
+    paymentAxis->setRange(0, maxPayment * 1.1);
+    paymentAxis->setVisible(true);
+}
+
+void AmortizationCalc::clearSimulationBands() {
+    if (!balanceMedianSeries)
+        return;
+    for (QAreaSeries *band : {balanceOuterBand, balanceInnerBand, paymentBand}) {
+        band->upperSeries()->clear();
+        band->lowerSeries()->clear();
+    }
+    balanceMedianSeries->clear();
+    paymentMedianSeries->clear();
+    paymentAxis->setVisible(false);
+}
+
+std::shared_ptr<const Schedule> AmortizationCalc::cachedSchedule(const ScenarioKey &key) {
+    if (std::shared_ptr<const Schedule> cached = scenarioCache.find(key))
+        return cached;
+    auto computed = std::make_shared<Schedule>();
+    key.loadPrepayments(*computed);
+    amortize(key.terms, *computed, key.arithmetic);
+    scenarioCache.insert(key, computed);
+    return computed;
+}
+
+void AmortizationCalc::updateCacheLabel() {
+    const ScenarioCache::Counters &counters = scenarioCache.counters();
+    cacheLabel->setText(QString("Cache: %1 schedules, %2 of %3 MB, %4 hits, %5 misses, %6 evictions")
+                            .arg(scenarioCache.size())
+                            .arg(scenarioCache.bytesUsed() / double(1 << 20), 0, 'f', 1)
+                            .arg(scenarioCache.byteBudget() >> 20)
+                            .arg(counters.hits)
+                            .arg(counters.misses)
+                            .arg(counters.evictions));
+}
+
+void AmortizationCalc::saveScenario() {
+    if (!isValid(currentTerms)) {
+        resultLabel->setText("Calculate a schedule before saving it as a scenario.");
+        return;
+    }
+    bool ok = false;
+    QString name = QInputDialog::getText(this, "Save Scenario", "Name:", QLineEdit::Normal,
+                                         QString("Scenario %1").arg(scenarios.size() + 1), &ok);
+    if (!ok || name.isEmpty())
+        return;
+
+    // The shown schedule may include one-time payment edits, so cache it as it is
+    SavedScenario scenario;
+    scenario.key = ScenarioKey::make(currentTerms, chartInYears, currentArithmetic,
+                                     prepaymentPlan.events(currentTerms.months));
+    scenario.plan = prepaymentPlan;
+    scenarioCache.insert(scenario.key, std::make_shared<const Schedule>(schedule));
+    scenarios.push_back(std::move(scenario));
+
+    auto *item = new QListWidgetItem(name);
+    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+    item->setCheckState(Qt::Unchecked);
+    item->setToolTip(QString("$%1 at %2% over %3 months, %4")
+                         .arg(QLocale::system().toString(currentTerms.principal, 'f', 2))
+                         .arg(currentTerms.annualRate)
+                         .arg(currentTerms.months)
+                         .arg(arithmeticBox->itemText(int(currentArithmetic))));
+    scenarioList->addItem(item);
+    updateCacheLabel();
+}
+
+void AmortizationCalc::removeScenario() {
+    int row = scenarioList->currentRow();
+    if (row < 0)
+        return;
+    if (QLineSeries *overlay = scenarios[row].overlay) {
+        chartView->chart()->removeSeries(overlay);
+        delete overlay;
+    }
+    scenarios.erase(scenarios.begin() + row);
+    delete scenarioList->takeItem(row);
+    refreshOverlays(); // the y range may shrink
+}
+
+void AmortizationCalc::switchScenario(QListWidgetItem *item) {
+    const SavedScenario &scenario = scenarios[scenarioList->row(item)];
+    const ScenarioKey &key = scenario.key;
+    principalEdit->setText(QString::number(key.terms.principal, 'f', 2));
+    rateEdit->setText(QString::number(key.terms.annualRate));
+    termEdit->setText(QString::number(key.inYears ? key.terms.months / 12.0 : key.terms.months));
+    termTypeBox->setCurrentText(key.inYears ? "Years" : "Months");
+    arithmeticBox->setCurrentIndex(int(key.arithmetic));
+    prepaymentPlan = scenario.plan;
+    savePrepayments();
+    refreshRuleList();
+    calculate(); // served from the cache unless it was evicted
+}
+
+void AmortizationCalc::refreshOverlays() {
+    PHASE_SCOPE("calculate/overlays");
+    QChart *chart = chartView->chart();
+    const int step = chartInYears ? 12 : 1;
+    const int maxPoints = std::max(100, int(chart->plotArea().width()));
+    overlayMaxY = 0.0;
+
+    for (std::size_t i = 0; i < scenarios.size(); ++i) {
+        SavedScenario &scenario = scenarios[i];
+        QListWidgetItem *item = scenarioList->item(int(i));
+        if (item->checkState() != Qt::Checked) {
+            if (scenario.overlay) {
+                chart->removeSeries(scenario.overlay);
+                delete scenario.overlay;
+                scenario.overlay = nullptr;
+            }
+            continue;
+        }
+
+        if (!scenario.overlay) {
+            scenario.overlay = new QLineSeries();
+            QPen pen = scenario.overlay->pen();
+            pen.setStyle(Qt::DashLine);
+            scenario.overlay->setPen(pen);
+            chart->addSeries(scenario.overlay);
+            chart->setAxisX(chart->axisX(), scenario.overlay);
+            chart->setAxisY(chart->axisY(), scenario.overlay);
+        }
+        scenario.overlay->setName(item->text());
+
+        // Total paid, on the same month or year axis as the current schedule
+        std::shared_ptr<const Schedule> overlaySchedule = cachedSchedule(scenario.key);
+        const int months = overlaySchedule->periods;
+        const int count = (months + step - 1) / step;
+        QList<QPointF> points(count);
+        for (int p = 0; p < count; ++p) {
+            int row = std::min((p + 1) * step, months) - 1;
+            points[p] = QPointF(p + 1, overlaySchedule->cumulativePrincipal[row]
+                                           + overlaySchedule->cumulativeInterest[row]);
+        }
+        if (count > 0)
+            overlayMaxY = std::max(overlayMaxY, points[count - 1].y());
+        scenario.overlay->replace(decimateMinMax(points, -std::numeric_limits<double>::infinity(),
+                                                 std::numeric_limits<double>::infinity(), maxPoints));
+    }
+
+    QValueAxis *axisY = qobject_cast<QValueAxis *>(chart->axisY());
+    if (axisY) {
+        double total = totalPoints.isEmpty() ? 0.0 : totalPoints.back().y();
+        axisY->setRange(0, std::max(total, overlayMaxY));
+    }
+    updateCacheLabel();
+}
+
+void AmortizationCalc::addPrepaymentRule() {
+    PrepaymentRule rule;
+    rule.amount = ruleAmountEdit->text().remove(',').toDouble();
+    rule.interval = ruleIntervalEdit->text().toInt();
+    rule.firstMonth = ruleFirstMonthEdit->text().toInt();
+    rule.lastMonth = ruleLastMonthEdit->text().toInt(); // blank runs to the end
+    if (!isValid(rule)) {
+        solverLabel->setText("Enter an amount, an interval and a first month for the recurring payment.");
+        return;
+    }
+    prepaymentPlan.addRule(rule);
+    savePrepayments();
+    refreshRuleList();
+    prepaymentChanged(rule.firstMonth - 1);
+}
+
+void AmortizationCalc::removePrepaymentRule() {
+    int row = ruleList->currentRow();
+    if (row < 0)
+        return;
+    int firstMonth = prepaymentPlan.rules()[row].firstMonth;
+    prepaymentPlan.removeRule(row);
+    savePrepayments();
+    refreshRuleList();
+    prepaymentChanged(firstMonth - 1);
+}
+
+void AmortizationCalc::importPrepaymentFile() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Import Payments", "", "Payment Files (*.csv *.txt);;All Files (*)");
+    if (fileName.isEmpty())
+        return;
+
+    long long skipped = 0;
+    if (!importPrepayments(QFile::encodeName(fileName).toStdString(), prepaymentPlan, &skipped)) {
+        solverLabel->setText("Failed to read " + fileName);
+        return;
+    }
+    savePrepayments();
+    solverLabel->setText(QString("Imported payments: %1 months now have one (%2 lines skipped).")
+                             .arg(prepaymentPlan.oneTimePayments().size())
+                             .arg(skipped));
+    prepaymentChanged(0);
+}
+
+void AmortizationCalc::clearPrepayments() {
+    prepaymentPlan.clear();
+    savePrepayments();
+    refreshRuleList();
+    prepaymentChanged(0);
+}
+
+void AmortizationCalc::refreshRuleList() {
+    QLocale locale = QLocale::system();
+    ruleList->clear();
+    for (const PrepaymentRule &rule : prepaymentPlan.rules()) {
+        QString every = rule.interval == 1 ? QString("every month") : QString("every %1 months").arg(rule.interval);
+        QString text = QString("$%1 %2 from month %3")
+                           .arg(locale.toString(rule.amount, 'f', 2))
+                           .arg(every)
+                           .arg(rule.firstMonth);
+        if (rule.lastMonth > 0)
+            text += QString(" to %1").arg(rule.lastMonth);
+        ruleList->addItem(text);
+    }
+}
+
+// Payments are kept between runs as "month:amount" and
+// "first:interval:last:amount" strings.
+void AmortizationCalc::savePrepayments() const {
+    QStringList oneTime;
+    for (const Prepayment &p : prepaymentPlan.oneTimePayments())
+        oneTime << QString("%1:%2").arg(p.month).arg(p.amount, 0, 'g', 17);
+    QStringList rules;
+    for (const PrepaymentRule &rule : prepaymentPlan.rules()) {
+        rules << QString("%1:%2:%3:%4").arg(rule.firstMonth).arg(rule.interval).arg(rule.lastMonth)
+                     .arg(rule.amount, 0, 'g', 17);
+    }
+    QSettings settings;
+    settings.setValue("prepayments/oneTime", oneTime);
+    settings.setValue("prepayments/rules", rules);
+}
+
+void AmortizationCalc::restorePrepayments() {
+    QSettings settings;
+    std::vector<Prepayment> payments;
+    for (const QString &entry : settings.value("prepayments/oneTime").toStringList()) {
+        QStringList fields = entry.split(':');
+        if (fields.size() == 2)
+            payments.push_back({fields[0].toInt(), fields[1].toDouble()});
+    }
+    prepaymentPlan.clear();
+    prepaymentPlan.addOneTime(payments);
+    for (const QString &entry : settings.value("prepayments/rules").toStringList()) {
+        QStringList fields = entry.split(':');
+        if (fields.size() == 4)
+            prepaymentPlan.addRule({fields[0].toInt(), fields[1].toInt(), fields[2].toInt(), fields[3].toDouble()});
+    }
+    refreshRuleList();
+}
+
+void AmortizationCalc::setPhaseTiming(bool enabled) {
+    PhaseTimer::setEnabled(enabled);
+    phaseOverlay->setVisible(enabled);
+}
+
+void AmortizationCalc::saveTrace() {
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Timing Trace", "", "Chrome Trace (*.json)");
+    if (fileName.isEmpty())
+        return;
+    if (PhaseTimer::writeChromeTrace(QFile::encodeName(fileName).toStdString()))
+        resultLabel->setText("Saved timing trace to: " + fileName);
+    else
+        resultLabel->setText("Could not write " + fileName);
+}
+
+void AmortizationCalc::exportFinished() {
+    if (exportProgress) {
+        exportProgress->deleteLater();
+        exportProgress = nullptr;
+    }
+    exportButton->setEnabled(true);
+    exportScenariosButton->setEnabled(true);
+
+    QFuture<int> future = exportWatcher->future();
+    if (future.isCanceled() || future.resultCount() == 0) {
+        resultLabel->setText("Export cancelled.");
+    } else if (ExportStatus(future.result()) == ExportStatus::Failed) {
+        resultLabel->setText("Failed to open file for writing.");
+    } else {
+        resultLabel->setText("Exported table to: " + exportFileName);
+    }
+}
+
+void AmortizationCalc::rebuildHoverIndex() {
+    QChart *chart = chartView->chart();
+    QValueAxis *axisX = qobject_cast<QValueAxis *>(chart->axisX());
+    QValueAxis *axisY = qobject_cast<QValueAxis *>(chart->axisY());
+    if (!axisX || !axisY)
+        return;
+    QRectF dataRange(axisX->min(), axisY->min(), axisX->max() - axisX->min(), axisY->max() - axisY->min());
+    // Same order as the labels in eventFilter()
+    hoverIndex.rebuild(chart->plotArea(), dataRange,
+                       {principalSeries->points(), interestSeries->points(), totalSeries->points()});
 }
 
 bool AmortizationCalc::eventFilter(QObject *obj, QEvent *event) {
     if (obj == chartView->viewport()) {
         if (event->type() == QEvent::MouseMove) {
+            PHASE_SCOPE("hover");
             QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
 
-            auto findNearest = [&](QLineSeries *series) -> std::pair<QPointF, double> {
-                QPointF nearest;
-                double minDist = std::numeric_limits<double>::max();
-                for (const QPointF &pt : series->points()) {
-                    QPointF ptPixel = chartView->chart()->mapToPosition(pt, series);
-                    double dist = std::hypot(ptPixel.x() - mouseEvent->pos().x(), ptPixel.y() - mouseEvent->pos().y());
-                    if (dist < minDist) {
-                        minDist = dist;
-                        nearest = pt;
-                    }
-                }
-                return {nearest, minDist};
-            };
-
             const double threshold = 10.0; // pixels
 
-            auto [pPt, pDist] = findNearest(principalSeries);
-            auto [iPt, iDist] = findNearest(interestSeries);
-            auto [tPt, tDist] = findNearest(totalSeries);
-
-            double minDist = std::min({pDist, iDist, tDist});
-            QString tip;
-            if (minDist < threshold) {
-                if (minDist == pDist) {
-                    tip = QString("Principal\nX: %1\nY: %2").arg(pPt.x()).arg(pPt.y(), 0, 'f', 2);
-                } else if (minDist == iDist) {
-                    tip = QString("Interest\nX: %1\nY: %2").arg(iPt.x()).arg(iPt.y(), 0, 'f', 2);
-                } else {
-                    tip = QString("Total\nX: %1\nY: %2").arg(tPt.x()).arg(tPt.y(), 0, 'f', 2);
-                }
+            if (!hoverIndex.isValid()) {
+                PHASE_SCOPE("hover/rebuildIndex");
+                rebuildHoverIndex();
+            }
+            HoverIndex::Hit hit;
+            {
+                PHASE_SCOPE("hover/lookup");
+                hit = hoverIndex.nearest(mouseEvent->position(), threshold);
+            }
+
+            PHASE_SCOPE("hover/tooltip");
+            static const char *const seriesNames[] = {"Principal", "Interest", "Total"};
+            if (hit.series >= 0) {
+                QString tip = QString("%1\nX: %2\nY: %3")
+                    .arg(seriesNames[hit.series])
+                    .arg(hit.point.x())
+                    .arg(hit.point.y(), 0, 'f', 2);
                 lastTooltipText = tip;
                 lastTooltipPos = mouseEvent->globalPos();
                 tooltipActive = true;
@@ -438,7 +1507,7 @@ bool AmortizationCalc::eventFilter(QObject *obj, QEvent *event) {
                 tooltipTimer->stop();
                 QToolTip::hideText();
             }
-            return true;
+            return false; // let the chart view track the rubber band
         }
         if (event->type() == QEvent::Leave) {
             tooltipActive = false;
@@ -451,7 +1520,17 @@ bool AmortizationCalc::eventFilter(QObject *obj, QEvent *event) {
 }
 
 int main(int argc, char *argv[]) {
+    // Batch and server runs never touch the GUI, so decide before creating QApplication
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch") == 0)
+            return runBatch(argc, argv);
+        if (std::strcmp(argv[i], "--serve") == 0)
+            return runServe(argc, argv);
+    }
+
     QApplication app(argc, argv);
+    app.setOrganizationName("amortizationCalcQt");
+    app.setApplicationName("amortizationCalcQt"); // where QSettings keeps the payment plan
     AmortizationCalc window;
     window.setWindowTitle("Amortization Calculator");
     window.resize(1300, 600); // Set default size to 1300x600
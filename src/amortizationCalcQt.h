@@ -5,20 +5,89 @@
 #include <QComboBox>
 #include <QPushButton>
 #include <QLabel>
-#include <QTableWidget>
+#include <QCheckBox>
+#include <QSlider>
+#include <QTableView>
+#include <QListWidget>
+#include <QSpinBox>
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
+#include <QtCharts/QAreaSeries>
+#include <QtCharts/QValueAxis>
 #include <QTimer>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <QElapsedTimer>
+#include <memory>
+#include "amortizationEngine.h"
+#include "centsAmortization.h"
+#include "scheduleModel.h"
+#include "hoverIndex.h"
+#include "heatmapWidget.h"
+#include "phaseOverlay.h"
+#include "loanFile.h"
+#include "loanSolvers.h"
+#include "portfolio.h"
+#include "prepaymentPlan.h"
+#include "rateSimulation.h"
+#include "scenarioCache.h"
+#include "threadPool.h"
+
+// A schedule computed off the UI thread for live mode.
+struct LiveResult {
+    quint64 generation = 0;
+    LoanTerms terms;
+    bool inYears = false;
+    Arithmetic arithmetic = Arithmetic::Double;
+    bool complete = false;
+    PrepaymentPlan plan;
+    ScenarioKey key; // cached under this once complete
+    Schedule schedule;
+};
+
+// A scenario in the list; its schedule lives in the cache, not here.
+struct SavedScenario {
+    ScenarioKey key;
+    PrepaymentPlan plan; // restored on switching, rules and all
+    QLineSeries *overlay = nullptr; // shown while the item is checked
+};
 
 class AmortizationCalc : public QWidget {
     Q_OBJECT
 
 public:
     explicit AmortizationCalc(QWidget *parent = nullptr);
+    ~AmortizationCalc();
 
 private slots:
     void calculate();
     void exportCsv();
+    void exportScenarios();
+    void exportFinished();
+    void saveSchedule();
+    void openSchedule();
+    void prepaymentChanged(int row);
+    void solveExtraPayment();
+    void solveBreakEvenRate();
+    void computeGrid();
+    void gridFinished();
+    void simulateRates();
+    void simulationFinished();
+    void loadPortfolio();
+    void portfolioFinished();
+    void setPhaseTiming(bool enabled);
+    void saveTrace();
+    void scheduleLiveUpdate();
+    void startLiveUpdate();
+    void liveUpdateFinished();
+    void saveScenario();
+    void removeScenario();
+    void switchScenario(QListWidgetItem *item);
+    void refreshOverlays();
+    void addPrepaymentRule();
+    void removePrepaymentRule();
+    void importPrepaymentFile();
+    void clearPrepayments();
 
 private:
     QLineEdit *principalEdit;
@@ -26,14 +95,21 @@ private:
     QLineEdit *termEdit;
     QComboBox *typeBox;
     QComboBox *termTypeBox;
+    QComboBox *arithmeticBox;
     QPushButton *calcButton;
+    QCheckBox *liveBox;
+    QSlider *rateSlider;
     QPushButton *exportButton;
+    QPushButton *saveButton;
+    QPushButton *openButton;
+    QPushButton *portfolioButton;
     QLabel *resultLabel;
     QLabel *totalInterestLabel;
     QLabel *monthsPaidLabel;
     QLabel *totalPaidLabel;
     QLabel *termLabel;
-    QTableWidget *table;
+    QTableView *table;
+    ScheduleModel *scheduleModel;
     QChartView *chartView;
     QLineSeries *principalSeries;
     QLineSeries *interestSeries;
@@ -42,6 +118,94 @@ private:
     bool tooltipActive = false;
     QString lastTooltipText;
     QPoint lastTooltipPos;
+    Schedule schedule;
+    PrepaymentPlan prepaymentPlan; // the extra payments; schedule.prepayment is its expansion
+    LoanTerms currentTerms;     // terms the schedule was computed for
+    Arithmetic currentArithmetic = Arithmetic::Double; // and the engine it used
+    bool chartInYears = false;
+    QList<QPointF> principalPoints;
+    QList<QPointF> interestPoints;
+    QList<QPointF> totalPoints;
+    bool updatingAxes = false;
+    int lastPlotWidth = 0;
+    HoverIndex hoverIndex;
+    QFutureWatcher<int> *exportWatcher;
+    QProgressDialog *exportProgress = nullptr;
+    QString exportFileName;
+    QLineEdit *targetMonthEdit;
+    QLineEdit *targetInterestEdit;
+    QPushButton *solveExtraButton;
+    QPushButton *solveRateButton;
+    QComboBox *gridAxisBox;
+    QPushButton *gridButton;
+    QLabel *solverLabel;
+    HeatmapWidget *heatmap;
+    QFutureWatcher<SensitivityGrid> *gridWatcher;
+    QElapsedTimer gridTimer;
+    QLineEdit *fixedMonthsEdit;
+    QLineEdit *resetMonthsEdit;
+    QLineEdit *marginEdit;
+    QLineEdit *volatilityEdit;
+    QLineEdit *pathsEdit;
+    QPushButton *simulateButton;
+    QFutureWatcher<SimulationResult> *simulationWatcher;
+    QElapsedTimer simulationTimer;
+    LoanTerms simulationTerms;        // the schedule the running simulation was started for
+    quint64 simulationGeneration = 0; // liveGeneration at that point
+    QAreaSeries *balanceOuterBand = nullptr;
+    QAreaSeries *balanceInnerBand = nullptr;
+    QLineSeries *balanceMedianSeries = nullptr; // null until the first simulation
+    QAreaSeries *paymentBand = nullptr;
+    QLineSeries *paymentMedianSeries = nullptr;
+    QValueAxis *paymentAxis = nullptr;
+    QFutureWatcher<PortfolioResult> *portfolioWatcher;
+    QElapsedTimer portfolioTimer;
+    bool showingPortfolio = false; // the schedule is a book's aggregate, not one loan
+    double portfolioPrincipal = 0.0;
+    QCheckBox *timingBox = nullptr;
+    QPushButton *traceButton = nullptr;
+    PhaseOverlay *phaseOverlay;
+    QTimer *liveTimer;
+    QFutureWatcher<std::shared_ptr<LiveResult>> *liveWatcher;
+    std::shared_ptr<std::atomic<bool>> liveCancel; // set to abandon the running job
+    quint64 liveGeneration = 0;                    // bumped by every edit and synchronous publish
+    bool livePending = false;
+    std::unique_ptr<ThreadPool> computePool; // shared by the parallel engine features
+    ScenarioCache scenarioCache;
+    std::vector<SavedScenario> scenarios; // parallel to the rows of scenarioList
+    QListWidget *scenarioList;
+    QPushButton *saveScenarioButton;
+    QPushButton *removeScenarioButton;
+    QPushButton *exportScenariosButton;
+    QSpinBox *cacheBudgetBox;
+    QLabel *cacheLabel;
+    double overlayMaxY = 0.0; // largest overlay total, so the y axis fits them all
+    QLineEdit *ruleAmountEdit;
+    QLineEdit *ruleIntervalEdit;
+    QLineEdit *ruleFirstMonthEdit;
+    QLineEdit *ruleLastMonthEdit;
+    QPushButton *addRuleButton;
+    QListWidget *ruleList;
+    QPushButton *removeRuleButton;
+    QPushButton *importPaymentsButton;
+    QPushButton *clearPaymentsButton;
+
+    LoanTerms readTerms() const;
+    LoanRecord currentLoan() const;
+    Arithmetic selectedArithmetic() const;
+    std::shared_ptr<const Schedule> cachedSchedule(const ScenarioKey &key);
+    void updateCacheLabel();
+    void startExport(const QString &fileName, std::vector<std::shared_ptr<const Schedule>> schedules);
+    void refreshRuleList();
+    void savePrepayments() const;
+    void restorePrepayments();
+    void showSimulationBands(const SimulationResult &result);
+    void clearSimulationBands();
+    void publishSchedule();
+    void updateSummary();
+    void updateChart(int firstRow);
+    void refreshSeries();
+    void rebuildHoverIndex();
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
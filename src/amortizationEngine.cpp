@@ -0,0 +1,144 @@
+#include "amortizationEngine.h"
+#include <algorithm>
+#include <cmath>
+
+int termToMonths(double termValue, TermUnit unit) {
+    double months = unit == TermUnit::Years ? termValue * 12 : termValue;
+    // Range-checked before the cast, which is undefined for inf or 1e12
+    if (!(months >= 0 && months <= maxTermMonths))
+        return 0;
+    return static_cast<int>(months);
+}
+
+bool isValid(const LoanTerms &terms) {
+    return terms.principal > 0 && std::isfinite(terms.principal) && terms.annualRate > 0
+        && std::isfinite(terms.annualRate) && terms.months > 0 && terms.months <= maxTermMonths;
+}
+
+double levelPayment(const LoanTerms &terms) {
+    double monthlyRate = terms.annualRate / 12.0 / 100.0;
+    return (terms.principal * monthlyRate) / (1 - std::pow(1 + monthlyRate, -terms.months));
+}
+
+void Schedule::resize(int n) {
+    payment.resize(n);
+    principal.resize(n);
+    interest.resize(n);
+    balance.resize(n);
+    prepayment.resize(n, 0.0);
+    cumulativePrincipal.resize(n);
+    cumulativeInterest.resize(n);
+    periods = n;
+}
+
+void Schedule::clearPrepayments() {
+    std::fill(prepayment.begin(), prepayment.end(), 0.0);
+}
+
+namespace {
+
+// Rows firstRow..periods-1 from the checkpoint at firstRow - 1. Returns
+// false, leaving the rest of the schedule stale, if cancelled is set.
+bool fillRows(const LoanTerms &terms, Schedule &schedule, int firstRow, const std::atomic<bool> *cancelled) {
+    const int months = schedule.periods;
+    if (firstRow < 0) firstRow = 0;
+    if (firstRow >= months)
+        return true;
+
+    const double monthlyRate = terms.annualRate / 12.0 / 100.0;
+    const double monthlyPayment = schedule.monthlyPayment;
+
+    double *payment = schedule.payment.data();
+    double *principal = schedule.principal.data();
+    double *interest = schedule.interest.data();
+    double *balance = schedule.balance.data();
+    double *cumPrincipal = schedule.cumulativePrincipal.data();
+    double *cumInterest = schedule.cumulativeInterest.data();
+    const double *prepayment = schedule.prepayment.data();
+
+    // Resume from the checkpoint left by the previous row
+    double remaining = firstRow == 0 ? terms.principal : balance[firstRow - 1];
+    double totalPrincipal = firstRow == 0 ? 0.0 : cumPrincipal[firstRow - 1];
+    double totalInterest = firstRow == 0 ? 0.0 : cumInterest[firstRow - 1];
+    int paidOff = firstRow == 0 ? months : schedule.paidOffPeriod;
+
+    int i = firstRow;
+    if (remaining > 0) {
+        paidOff = months;
+        for (; i < months; ++i) {
+            if (cancelled && (i & 4095) == 0 && cancelled->load(std::memory_order_relaxed))
+                return false;
+
+            double rowInterest = remaining * monthlyRate;
+            double rowPrincipal = monthlyPayment - rowInterest;
+
+            // Last payment and early payoff both settle exactly the remaining balance
+            if (i == months - 1 || rowPrincipal > remaining)
+                rowPrincipal = remaining;
+
+            remaining -= rowPrincipal;
+            remaining -= prepayment[i];
+            if (remaining < 0) remaining = 0;
+
+            totalPrincipal += rowPrincipal;
+            totalInterest += rowInterest;
+
+            payment[i] = rowPrincipal + rowInterest;
+            principal[i] = rowPrincipal;
+            interest[i] = rowInterest;
+            balance[i] = remaining;
+            cumPrincipal[i] = totalPrincipal;
+            cumInterest[i] = totalInterest;
+
+            if (remaining <= 0) {
+                paidOff = i + 1;
+                ++i;
+                break;
+            }
+        }
+    }
+
+    // Rows after an early payoff are zero; the running totals stay flat
+    std::fill(payment + i, payment + months, 0.0);
+    std::fill(principal + i, principal + months, 0.0);
+    std::fill(interest + i, interest + months, 0.0);
+    std::fill(balance + i, balance + months, 0.0);
+    std::fill(cumPrincipal + i, cumPrincipal + months, totalPrincipal);
+    std::fill(cumInterest + i, cumInterest + months, totalInterest);
+
+    schedule.paidOffPeriod = paidOff;
+    schedule.totalInterest = totalInterest;
+    return true;
+}
+
+} // namespace
+
+bool amortize(const LoanTerms &terms, Schedule &schedule) {
+    if (!isValid(terms)) {
+        schedule.resize(0);
+        schedule.paidOffPeriod = 0;
+        schedule.monthlyPayment = 0.0;
+        schedule.totalInterest = 0.0;
+        return false;
+    }
+
+    schedule.resize(terms.months);
+    schedule.monthlyPayment = levelPayment(terms);
+    amortizeFrom(terms, schedule, 0);
+    return true;
+}
+
+bool amortize(const LoanTerms &terms, Schedule &schedule, const std::atomic<bool> &cancelled) {
+    if (!isValid(terms))
+        return amortize(terms, schedule);
+
+    schedule.resize(terms.months);
+    schedule.monthlyPayment = levelPayment(terms);
+    return fillRows(terms, schedule, 0, &cancelled);
+}
+
+void amortizeFrom(const LoanTerms &terms, Schedule &schedule, int firstRow) {
+    fillRows(terms, schedule, firstRow, nullptr);
+}
+
+
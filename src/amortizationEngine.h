@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// Headless amortization engine. Nothing in here depends on Qt so it can be
+// linked into batch tools as well as the GUI.
+
+enum class TermUnit { Years, Months };
+
+struct LoanTerms {
+    double principal = 0.0;
+    double annualRate = 0.0; // percent, e.g. 6.5
+    int months = 0;
+};
+
+inline bool operator==(const LoanTerms &a, const LoanTerms &b) {
+    return a.principal == b.principal && a.annualRate == b.annualRate && a.months == b.months;
+}
+inline bool operator!=(const LoanTerms &a, const LoanTerms &b) { return !(a == b); }
+
+// Longest term accepted, so one input line or request cannot ask for
+// gigabytes of schedule.
+const int maxTermMonths = 100000;
+
+// Whole months in termValue; 0 (an invalid term) if it is negative, not
+// finite or longer than maxTermMonths.
+int termToMonths(double termValue, TermUnit unit);
+bool isValid(const LoanTerms &terms);
+double levelPayment(const LoanTerms &terms);
+
+// Struct-of-arrays schedule. Each column holds one value per month; the
+// buffers are reused across calls so recomputing never allocates per row.
+struct Schedule {
+    std::vector<double> payment;
+    std::vector<double> principal;
+    std::vector<double> interest;
+    std::vector<double> balance;
+    std::vector<double> prepayment; // one-time payment applied after each month
+
+    // Running totals through each row. Together with balance they checkpoint
+    // the loan state so a suffix of the schedule can be recomputed alone.
+    std::vector<double> cumulativePrincipal;
+    std::vector<double> cumulativeInterest;
+
+    int periods = 0;
+    int paidOffPeriod = 0; // 1-based month in which the balance reaches zero
+    double monthlyPayment = 0.0;
+    double totalInterest = 0.0;
+
+    // Resizes every column to n rows. Existing prepayments are kept, new rows
+    // start at zero, and capacity is never released.
+    void resize(int n);
+    void clearPrepayments();
+};
+
+// Fills schedule with the amortization of terms, reading prepayments from
+// schedule.prepayment. Returns false (and leaves an empty schedule) if the
+// terms are not valid.
+bool amortize(const LoanTerms &terms, Schedule &schedule);
+// As above, but gives up between blocks of rows once cancelled is set,
+// returning false with the schedule only partly filled.
+bool amortize(const LoanTerms &terms, Schedule &schedule, const std::atomic<bool> &cancelled);
+
+// Recomputes rows firstRow..periods-1 from the checkpoint at firstRow - 1,
+// e.g. after a prepayment at firstRow changed. schedule must already hold an
+// amortization of the same terms.
+void amortizeFrom(const LoanTerms &terms, Schedule &schedule, int firstRow);
@@ -0,0 +1,291 @@
+#include "batchKernel.h"
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define AMORT_HAVE_X86_KERNELS 1
+#endif
+
+namespace {
+
+const int laneMultiple = 8; // widest vector: 8 doubles with AVX-512
+const int lanesPerBlock = 512; // keeps a block's state resident in cache
+
+// Reference lane-by-lane version; written with selects so it mirrors the
+// vector kernels exactly.
+bool stepScalar(LoanBatch &b, int period, const double *prepayment, const BatchRows *rows, BatchTotals *totals) {
+    const double p = period;
+    double sumPrincipal = 0.0, sumInterest = 0.0, sumBalance = 0.0;
+    bool open = false;
+    for (int i = 0; i < b.lanes; ++i) {
+        double remaining = b.balance[i];
+        bool active = remaining > 0;
+        double interest = remaining * b.monthlyRate[i];
+        double principal = b.payment[i] - interest;
+        bool settle = p == b.lastPeriod[i] || principal > remaining;
+        principal = settle ? remaining : principal;
+        double next = remaining - principal;
+        next = next - (prepayment ? prepayment[i] : 0.0);
+        next = next < 0 ? 0.0 : next;
+        bool paid = active && next <= 0;
+
+        b.balance[i] = active ? next : remaining;
+        open |= b.balance[i] > 0;
+        b.totalInterest[i] += active ? interest : 0.0;
+        b.paidOffPeriod[i] = paid ? p + 1 : b.paidOffPeriod[i];
+        if (rows) {
+            rows->payment[i] = active ? principal + interest : 0.0;
+            rows->principal[i] = active ? principal : 0.0;
+            rows->interest[i] = active ? interest : 0.0;
+            rows->balance[i] = active ? next : 0.0;
+        }
+        sumPrincipal += active ? principal : 0.0;
+        sumInterest += active ? interest : 0.0;
+        sumBalance += active ? next : 0.0;
+    }
+    if (totals)
+        *totals = {sumPrincipal, sumInterest, sumBalance};
+    return open;
+}
+
+#ifdef AMORT_HAVE_X86_KERNELS
+
+__attribute__((target("avx2")))
+inline double sumAvx2(__m256d v) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+__attribute__((target("avx2")))
+bool stepAvx2(LoanBatch &b, int period, const double *prepayment, const BatchRows *rows, BatchTotals *totals) {
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d sumPrincipal = zero, sumInterest = zero, sumBalance = zero;
+    __m256d open = zero;
+    const __m256d p = _mm256_set1_pd(period);
+    const __m256d nextPeriod = _mm256_set1_pd(period + 1);
+    for (int i = 0; i < b.lanes; i += 4) {
+        __m256d remaining = _mm256_loadu_pd(&b.balance[i]);
+        __m256d active = _mm256_cmp_pd(remaining, zero, _CMP_GT_OQ);
+        __m256d interest = _mm256_mul_pd(remaining, _mm256_loadu_pd(&b.monthlyRate[i]));
+        __m256d principal = _mm256_sub_pd(_mm256_loadu_pd(&b.payment[i]), interest);
+        __m256d settle = _mm256_or_pd(_mm256_cmp_pd(p, _mm256_loadu_pd(&b.lastPeriod[i]), _CMP_EQ_OQ),
+                                      _mm256_cmp_pd(principal, remaining, _CMP_GT_OQ));
+        principal = _mm256_blendv_pd(principal, remaining, settle);
+        __m256d next = _mm256_sub_pd(remaining, principal);
+        if (prepayment)
+            next = _mm256_sub_pd(next, _mm256_loadu_pd(&prepayment[i]));
+        next = _mm256_blendv_pd(next, zero, _mm256_cmp_pd(next, zero, _CMP_LT_OQ));
+        __m256d paid = _mm256_and_pd(active, _mm256_cmp_pd(next, zero, _CMP_LE_OQ));
+
+        __m256d balance = _mm256_blendv_pd(remaining, next, active);
+        _mm256_storeu_pd(&b.balance[i], balance);
+        open = _mm256_or_pd(open, _mm256_cmp_pd(balance, zero, _CMP_GT_OQ));
+        __m256d total = _mm256_loadu_pd(&b.totalInterest[i]);
+        _mm256_storeu_pd(&b.totalInterest[i], _mm256_add_pd(total, _mm256_and_pd(interest, active)));
+        __m256d paidOff = _mm256_loadu_pd(&b.paidOffPeriod[i]);
+        _mm256_storeu_pd(&b.paidOffPeriod[i], _mm256_blendv_pd(paidOff, nextPeriod, paid));
+        if (rows) {
+            _mm256_storeu_pd(&rows->payment[i], _mm256_and_pd(_mm256_add_pd(principal, interest), active));
+            _mm256_storeu_pd(&rows->principal[i], _mm256_and_pd(principal, active));
+            _mm256_storeu_pd(&rows->interest[i], _mm256_and_pd(interest, active));
+            _mm256_storeu_pd(&rows->balance[i], _mm256_and_pd(next, active));
+        }
+        if (totals) {
+            sumPrincipal = _mm256_add_pd(sumPrincipal, _mm256_and_pd(principal, active));
+            sumInterest = _mm256_add_pd(sumInterest, _mm256_and_pd(interest, active));
+            sumBalance = _mm256_add_pd(sumBalance, _mm256_and_pd(next, active));
+        }
+    }
+    if (totals)
+        *totals = {sumAvx2(sumPrincipal), sumAvx2(sumInterest), sumAvx2(sumBalance)};
+    return _mm256_movemask_pd(open) != 0;
+}
+
+__attribute__((target("avx512f")))
+inline double sumAvx512(__m512d v) {
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, v);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+__attribute__((target("avx512f")))
+bool stepAvx512(LoanBatch &b, int period, const double *prepayment, const BatchRows *rows, BatchTotals *totals) {
+    const __m512d zero = _mm512_setzero_pd();
+    __m512d sumPrincipal = zero, sumInterest = zero, sumBalance = zero;
+    __mmask8 open = 0;
+    const __m512d p = _mm512_set1_pd(period);
+    const __m512d nextPeriod = _mm512_set1_pd(period + 1);
+    for (int i = 0; i < b.lanes; i += 8) {
+        __m512d remaining = _mm512_loadu_pd(&b.balance[i]);
+        __mmask8 active = _mm512_cmp_pd_mask(remaining, zero, _CMP_GT_OQ);
+        __m512d interest = _mm512_mul_pd(remaining, _mm512_loadu_pd(&b.monthlyRate[i]));
+        __m512d principal = _mm512_sub_pd(_mm512_loadu_pd(&b.payment[i]), interest);
+        __mmask8 settle = _mm512_cmp_pd_mask(p, _mm512_loadu_pd(&b.lastPeriod[i]), _CMP_EQ_OQ)
+            | _mm512_cmp_pd_mask(principal, remaining, _CMP_GT_OQ);
+        principal = _mm512_mask_blend_pd(settle, principal, remaining);
+        __m512d next = _mm512_sub_pd(remaining, principal);
+        if (prepayment)
+            next = _mm512_sub_pd(next, _mm512_loadu_pd(&prepayment[i]));
+        next = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(next, zero, _CMP_LT_OQ), next, zero);
+        __mmask8 paid = active & _mm512_cmp_pd_mask(next, zero, _CMP_LE_OQ);
+
+        __m512d balance = _mm512_mask_blend_pd(active, remaining, next);
+        _mm512_storeu_pd(&b.balance[i], balance);
+        open |= _mm512_cmp_pd_mask(balance, zero, _CMP_GT_OQ);
+        __m512d total = _mm512_loadu_pd(&b.totalInterest[i]);
+        _mm512_storeu_pd(&b.totalInterest[i], _mm512_mask_add_pd(total, active, total, interest));
+        __m512d paidOff = _mm512_loadu_pd(&b.paidOffPeriod[i]);
+        _mm512_storeu_pd(&b.paidOffPeriod[i], _mm512_mask_blend_pd(paid, paidOff, nextPeriod));
+        if (rows) {
+            _mm512_storeu_pd(&rows->payment[i], _mm512_maskz_add_pd(active, principal, interest));
+            _mm512_storeu_pd(&rows->principal[i], _mm512_maskz_mov_pd(active, principal));
+            _mm512_storeu_pd(&rows->interest[i], _mm512_maskz_mov_pd(active, interest));
+            _mm512_storeu_pd(&rows->balance[i], _mm512_maskz_mov_pd(active, next));
+        }
+        if (totals) {
+            sumPrincipal = _mm512_mask_add_pd(sumPrincipal, active, sumPrincipal, principal);
+            sumInterest = _mm512_mask_add_pd(sumInterest, active, sumInterest, interest);
+            sumBalance = _mm512_mask_add_pd(sumBalance, active, sumBalance, next);
+        }
+    }
+    if (totals)
+        *totals = {sumAvx512(sumPrincipal), sumAvx512(sumInterest), sumAvx512(sumBalance)};
+    return open != 0;
+}
+
+#endif
+
+using StepFunction = bool (*)(LoanBatch &, int, const double *, const BatchRows *, BatchTotals *);
+
+struct Kernel {
+    StepFunction step;
+    const char *name;
+};
+
+const Kernel scalarKernel = {stepScalar, "scalar"};
+#ifdef AMORT_HAVE_X86_KERNELS
+const Kernel avx2Kernel = {stepAvx2, "avx2"};
+const Kernel avx512Kernel = {stepAvx512, "avx512"};
+#endif
+
+// The kernel for name if this CPU can run it, else null.
+const Kernel *supportedKernel(const std::string &name) {
+#ifdef AMORT_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (name == avx512Kernel.name && __builtin_cpu_supports("avx512f"))
+        return &avx512Kernel;
+    if (name == avx2Kernel.name && __builtin_cpu_supports("avx2"))
+        return &avx2Kernel;
+#endif
+    if (name == scalarKernel.name)
+        return &scalarKernel;
+    return nullptr;
+}
+
+const Kernel *selectKernel() {
+    for (const char *name : {"avx512", "avx2"}) {
+        if (const Kernel *k = supportedKernel(name))
+            return k;
+    }
+    return &scalarKernel;
+}
+
+std::atomic<const Kernel *> &kernel() {
+    static std::atomic<const Kernel *> selected(selectKernel());
+    return selected;
+}
+
+} // namespace
+
+void LoanBatch::assign(const LoanTerms *terms, int count) {
+    size = count;
+    lanes = (count + laneMultiple - 1) / laneMultiple * laneMultiple;
+    periods = 0;
+    for (std::vector<double> *column : {&monthlyRate, &payment, &lastPeriod, &balance, &totalInterest, &paidOffPeriod})
+        column->assign(lanes, 0.0);
+
+    for (int i = 0; i < count; ++i) {
+        if (!isValid(terms[i]))
+            continue;
+        monthlyRate[i] = terms[i].annualRate / 12.0 / 100.0;
+        payment[i] = levelPayment(terms[i]);
+        lastPeriod[i] = terms[i].months - 1;
+        balance[i] = terms[i].principal;
+        paidOffPeriod[i] = terms[i].months;
+        periods = std::max(periods, terms[i].months);
+    }
+}
+
+bool stepLoanBatch(LoanBatch &batch, int period, const double *prepayment, const BatchRows *rows,
+                   BatchTotals *totals) {
+    return kernel().load(std::memory_order_relaxed)->step(batch, period, prepayment, rows, totals);
+}
+
+const char *loanBatchKernel() {
+    return kernel().load(std::memory_order_relaxed)->name;
+}
+
+bool setLoanBatchKernel(const std::string &name) {
+    const Kernel *k = supportedKernel(name);
+    if (k)
+        kernel().store(k, std::memory_order_relaxed);
+    return k != nullptr;
+}
+
+void summarizeLoans(const LoanRecord *records, int count, std::vector<LoanSummary> &out) {
+    thread_local LoanBatch batch;
+    thread_local std::vector<LoanTerms> terms;
+    thread_local std::vector<double> prepayment;
+    struct Event {
+        int period;
+        int lane;
+        double amount;
+    };
+    thread_local std::vector<Event> events;
+
+    out.assign(count, LoanSummary());
+    for (int first = 0; first < count; first += lanesPerBlock) {
+        const int n = std::min(lanesPerBlock, count - first);
+        const LoanRecord *block = records + first;
+
+        terms.resize(n);
+        events.clear();
+        for (int i = 0; i < n; ++i) {
+            terms[i] = block[i].terms;
+            for (const Prepayment &p : block[i].prepayments) {
+                if (p.month >= 1 && p.month <= terms[i].months)
+                    events.push_back({p.month - 1, i, p.amount});
+            }
+        }
+        std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.period < b.period; });
+
+        batch.assign(terms.data(), n);
+        prepayment.assign(batch.lanes, 0.0);
+
+        // Stage each month's sparse prepayments into the dense lane array
+        std::size_t nextEvent = 0;
+        for (int period = 0; period < batch.periods; ++period) {
+            std::size_t firstEvent = nextEvent;
+            for (; nextEvent < events.size() && events[nextEvent].period == period; ++nextEvent)
+                prepayment[events[nextEvent].lane] += events[nextEvent].amount;
+            bool anyPrepayment = nextEvent > firstEvent;
+            bool open = stepLoanBatch(batch, period, anyPrepayment ? prepayment.data() : nullptr);
+            for (std::size_t e = firstEvent; e < nextEvent; ++e)
+                prepayment[events[e].lane] = 0.0;
+            // Paid-off lanes no longer change, so a block that is all paid
+            // off early (prepayments, short terms) is done
+            if (!open)
+                break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            if (!isValid(terms[i]))
+                continue;
+            LoanSummary &summary = out[first + i];
+            summary.monthlyPayment = batch.payment[i];
+            summary.totalInterest = batch.totalInterest[i];
+            summary.paidOffPeriod = static_cast<int>(batch.paidOffPeriod[i]);
+        }
+    }
+}
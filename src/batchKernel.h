@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "amortizationEngine.h"
+#include "loanFile.h"
+
+// Struct-of-arrays state for many loans advanced in lockstep, one month per
+// step. Lane counts are padded to a multiple of the widest vector, with the
+// padding lanes already paid off.
+struct LoanBatch {
+    std::vector<double> monthlyRate;
+    std::vector<double> payment;       // level payment
+    std::vector<double> lastPeriod;    // 0-based index of the final month
+    std::vector<double> balance;
+    std::vector<double> totalInterest;
+    std::vector<double> paidOffPeriod; // 1-based, as double so it can be blended
+
+    int size = 0;    // loans in the batch
+    int lanes = 0;   // size rounded up to the vector width
+    int periods = 0; // longest term in the batch
+
+    // Loads count loans, reusing the lane buffers. Invalid terms start paid off.
+    void assign(const LoanTerms *terms, int count);
+};
+
+// Optional per-step outputs, one value per lane; rows after payoff are zero.
+struct BatchRows {
+    double *payment = nullptr;
+    double *principal = nullptr;
+    double *interest = nullptr;
+    double *balance = nullptr;
+};
+
+// Optional per-step sums of the rows over every lane.
+struct BatchTotals {
+    double principal = 0.0;
+    double interest = 0.0;
+    double balance = 0.0;
+};
+
+// Advances every loan by one month. prepayment (lanes long, or null) holds
+// each loan's one-time payment for this month. Produces the same values as
+// amortize(): last-payment settlement and early payoff are applied with lane
+// masks instead of branches. Returns false once every lane is paid off.
+bool stepLoanBatch(LoanBatch &batch, int period, const double *prepayment, const BatchRows *rows = nullptr,
+                   BatchTotals *totals = nullptr);
+
+// Name of the kernel stepLoanBatch() dispatches to on this CPU:
+// "avx512", "avx2" or "scalar".
+const char *loanBatchKernel();
+
+// Makes stepLoanBatch() use the named kernel from then on, for checking the
+// kernels against each other. Returns false, changing nothing, if the name
+// is unknown or this CPU cannot run it.
+bool setLoanBatchKernel(const std::string &name);
+
+struct LoanSummary {
+    double monthlyPayment = 0.0;
+    double totalInterest = 0.0;
+    int paidOffPeriod = 0;
+};
+
+// Summarizes count loans (prepayments included) with the batch kernel.
+// Invalid loans get an all-zero summary.
+void summarizeLoans(const LoanRecord *records, int count, std::vector<LoanSummary> &out);
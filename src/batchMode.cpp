@@ -0,0 +1,337 @@
+#include "batchMode.h"
+#include "amortizationEngine.h"
+#include "batchKernel.h"
+#include "loanFile.h"
+#include "scheduleExport.h"
+#include "scheduleFile.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+
+namespace {
+
+struct BatchOptions {
+    std::string input;
+    std::string output; // empty writes to stdout
+    int threads = 0;
+    bool schedules = false;
+    bool binary = false;
+    bool verify = false;
+};
+
+struct ChunkResult {
+    std::string text;
+    long long loans = 0;
+    long long skipped = 0;
+    long long malformed = 0; // lines that are neither loans, blank nor comments
+    long long mismatches = 0;
+    // Binary output keeps the computed schedules instead of text
+    std::vector<LoanTerms> terms;
+    std::vector<Schedule> schedules;
+};
+
+void printUsage() {
+    std::fprintf(stderr,
+        "Usage: amortizationCalcQt --batch <loans.csv> [--output <results.csv>]\n"
+        "                          [--threads N] [--schedules | --binary | --verify]\n"
+        "\n"
+        "Input lines: principal,rate,term,years|months[,month:amount;...]\n"
+        "Writes one summary row per loan, or every month with --schedules.\n"
+        "--binary writes every schedule to --output in the columnar schedule format.\n"
+        "--verify cross-checks the vectorized summary kernel against the scalar engine\n"
+        "(summary rows only).\n");
+}
+
+bool parseOptions(int argc, char *argv[], BatchOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--batch") == 0 && hasValue) {
+            options.input = argv[++i];
+        } else if ((std::strcmp(arg, "--output") == 0 || std::strcmp(arg, "-o") == 0) && hasValue) {
+            options.output = argv[++i];
+        } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--schedules") == 0) {
+            options.schedules = true;
+        } else if (std::strcmp(arg, "--binary") == 0) {
+            options.binary = true;
+        } else if (std::strcmp(arg, "--verify") == 0) {
+            options.verify = true;
+        } else {
+            return false;
+        }
+    }
+    if (options.binary && (options.output.empty() || options.schedules))
+        return false;
+    // Only summary rows come from the vectorized kernel
+    if (options.verify && (options.schedules || options.binary))
+        return false;
+    return !options.input.empty();
+}
+
+// parseLoanLine also turns down blank lines, comments and a header row (a
+// first line starting with a letter); only other lines count as malformed.
+bool isMalformed(std::string_view text, long long lineNumber) {
+    std::size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos || text[first] == '#')
+        return false;
+    return lineNumber != 1 || !std::isalpha(static_cast<unsigned char>(text[first]));
+}
+
+// First pass for binary output, which needs the loan and row counts up front.
+bool countLoans(const std::string &path, std::uint64_t &loans, std::uint64_t &rows) {
+    LoanFileReader reader;
+    if (!reader.open(path))
+        return false;
+    LoanRecord record;
+    std::string block;
+    loans = rows = 0;
+    while (reader.readBlock(block)) {
+        std::string_view rest(block);
+        while (!rest.empty()) {
+            std::size_t end = rest.find('\n');
+            std::string_view text = rest.substr(0, end);
+            rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+            if (parseLoanLine(text, record) && isValid(record.terms)) {
+                ++loans;
+                rows += static_cast<std::uint64_t>(record.terms.months);
+            }
+        }
+    }
+    return true;
+}
+
+// Summary rows only need the totals, so every loan in the block goes through
+// the lockstep batch kernel.
+ChunkResult summarizeBlock(const std::string &block, long long firstLine, bool verify) {
+    thread_local std::vector<LoanRecord> records;
+    thread_local std::vector<long long> lineNumbers;
+    thread_local std::vector<LoanSummary> summaries;
+    thread_local Schedule schedule;
+
+    int count = 0;
+    long long malformed = 0;
+    lineNumbers.clear();
+    std::string_view rest(block);
+    long long line = firstLine;
+    while (!rest.empty()) {
+        std::size_t end = rest.find('\n');
+        std::string_view text = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        long long lineNumber = line++;
+
+        if (records.size() <= static_cast<std::size_t>(count))
+            records.resize(count + 1);
+        if (parseLoanLine(text, records[count])) {
+            lineNumbers.push_back(lineNumber);
+            ++count;
+        } else if (isMalformed(text, lineNumber)) {
+            ++malformed;
+        }
+    }
+
+    summarizeLoans(records.data(), count, summaries);
+
+    ChunkResult result;
+    result.malformed = malformed;
+    result.text.reserve(block.size() * 2);
+    std::string &out = result.text;
+    for (int i = 0; i < count; ++i) {
+        const LoanRecord &record = records[i];
+        const LoanSummary &summary = summaries[i];
+        if (!isValid(record.terms)) {
+            ++result.skipped;
+            continue;
+        }
+        ++result.loans;
+
+        if (verify) {
+            amortize(record, schedule);
+            double tolerance = 1e-9 * std::max(1.0, schedule.totalInterest);
+            if (schedule.paidOffPeriod != summary.paidOffPeriod
+                || std::fabs(schedule.totalInterest - summary.totalInterest) > tolerance)
+                ++result.mismatches;
+        }
+
+        appendInt(out, lineNumbers[i]);
+        out += ',';
+        appendMoney(out, summary.monthlyPayment);
+        out += ',';
+        appendMoney(out, summary.totalInterest);
+        out += ',';
+        appendMoney(out, record.terms.principal + summary.totalInterest);
+        out += ',';
+        appendInt(out, summary.paidOffPeriod);
+        out += '\n';
+    }
+    return result;
+}
+
+// Parses, amortizes and formats every loan in a block of lines.
+ChunkResult processBlock(const std::string &block, long long firstLine, const BatchOptions &options) {
+    if (!options.schedules && !options.binary)
+        return summarizeBlock(block, firstLine, options.verify);
+
+    thread_local Schedule schedule;
+    thread_local LoanRecord record;
+
+    ChunkResult result;
+    if (!options.binary)
+        result.text.reserve(block.size() * 256);
+
+    std::string_view rest(block);
+    long long line = firstLine;
+    while (!rest.empty()) {
+        std::size_t end = rest.find('\n');
+        std::string_view text = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        long long lineNumber = line++;
+
+        if (!parseLoanLine(text, record)) {
+            if (isMalformed(text, lineNumber))
+                ++result.malformed;
+            continue;
+        }
+        if (!amortize(record, schedule)) {
+            ++result.skipped;
+            continue;
+        }
+        ++result.loans;
+
+        std::string &out = result.text;
+        if (options.binary) {
+            result.terms.push_back(record.terms);
+            result.schedules.push_back(schedule);
+        } else {
+            for (int i = 0; i < schedule.periods; ++i) {
+                appendInt(out, lineNumber);
+                out += ',';
+                appendInt(out, i + 1);
+                out += ',';
+                appendMoney(out, schedule.payment[i]);
+                out += ',';
+                appendMoney(out, schedule.principal[i]);
+                out += ',';
+                appendMoney(out, schedule.interest[i]);
+                out += ',';
+                appendMoney(out, schedule.balance[i]);
+                out += ',';
+                appendMoney(out, schedule.prepayment[i]);
+                out += '\n';
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int runBatch(int argc, char *argv[]) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    LoanFileReader reader;
+    if (!reader.open(options.input)) {
+        std::fprintf(stderr, "Failed to open %s\n", options.input.c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::FILE *out = nullptr;
+    ScheduleFileWriter binaryOut;
+    if (options.binary) {
+        std::uint64_t loanCount = 0;
+        std::uint64_t rowCount = 0;
+        if (!countLoans(options.input, loanCount, rowCount)
+            || !binaryOut.open(options.output, loanCount, rowCount)) {
+            std::fprintf(stderr, "Failed to open %s for writing\n", options.output.c_str());
+            return 1;
+        }
+    } else {
+        out = options.output.empty() ? stdout : std::fopen(options.output.c_str(), "wb");
+        if (!out) {
+            std::fprintf(stderr, "Failed to open %s for writing\n", options.output.c_str());
+            return 1;
+        }
+        const char *header = options.schedules
+            ? "Line,Payment #,Payment,Principal,Interest,Balance,One-Time Payment\n"
+            : "Line,Monthly Payment,Total Interest,Total Paid,Months Paid\n";
+        std::fputs(header, out);
+    }
+    ThreadPool pool(options.threads);
+
+    // Blocks are processed out of order but written in order. Capping the
+    // number in flight bounds memory regardless of the input size.
+    const std::size_t blockBytes = (options.schedules || options.binary) ? (16 << 10) : (256 << 10);
+    const std::size_t maxInFlight = static_cast<std::size_t>(pool.size()) * 2;
+    std::deque<std::future<ChunkResult>> inFlight;
+    long long loans = 0;
+    long long skipped = 0;
+    long long malformed = 0;
+    long long mismatches = 0;
+    bool writeFailed = false;
+
+    auto writeOldest = [&]() {
+        ChunkResult result = inFlight.front().get();
+        inFlight.pop_front();
+        if (out)
+            std::fwrite(result.text.data(), 1, result.text.size(), out);
+        for (std::size_t i = 0; i < result.schedules.size(); ++i) {
+            if (!binaryOut.append(result.terms[i], result.schedules[i]))
+                writeFailed = true;
+        }
+        loans += result.loans;
+        skipped += result.skipped;
+        malformed += result.malformed;
+        mismatches += result.mismatches;
+    };
+
+    std::string block;
+    while (reader.readBlock(block, blockBytes)) {
+        long long firstLine = reader.blockFirstLine();
+        inFlight.push_back(pool.submit([block = std::move(block), firstLine, &options]() {
+            return processBlock(block, firstLine, options);
+        }));
+        block = std::string();
+        if (inFlight.size() >= maxInFlight)
+            writeOldest();
+    }
+    while (!inFlight.empty())
+        writeOldest();
+
+    if (options.binary) {
+        writeFailed = !binaryOut.close() || writeFailed;
+    } else {
+        writeFailed = std::ferror(out) != 0 || writeFailed;
+        if (out != stdout)
+            writeFailed = std::fclose(out) != 0 || writeFailed;
+        else
+            std::fflush(out);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr,
+                 "Computed %lld loans (%lld invalid, %lld malformed lines) on %d threads in %.3f s: %.0f loans/s\n",
+                 loans, skipped, malformed, pool.size(), seconds, seconds > 0 ? loans / seconds : 0.0);
+    if (options.verify) {
+        std::fprintf(stderr, "Verified %s kernel against scalar engine: %lld mismatches\n",
+                     loanBatchKernel(), mismatches);
+    }
+    if (writeFailed) {
+        std::fprintf(stderr, "Error writing results\n");
+        return 1;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
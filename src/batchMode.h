@@ -0,0 +1,6 @@
+#pragma once
+
+// Headless entry point used by main() when --batch is on the command line.
+// Computes every loan in a loan file on a thread pool and streams the
+// results to disk without creating any Qt objects.
+int runBatch(int argc, char *argv[]);
@@ -0,0 +1,243 @@
+#include "centsAmortization.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Annual percent in units of 1/10000 of a percent; monthly interest on a
+// balance in cents is then balance * rate / monthlyRateDenominator
+constexpr std::int64_t rateUnitsPerPercent = 10000;
+constexpr std::int64_t monthlyRateDenominator = 12 * 100 * rateUnitsPerPercent;
+
+std::int64_t rateUnits(const LoanTerms &terms) {
+    return std::llround(terms.annualRate * rateUnitsPerPercent);
+}
+
+bool withinCentsLimits(const LoanTerms &terms) {
+    return terms.principal <= maxCentsPrincipal && terms.annualRate <= maxCentsRate;
+}
+
+// Q.62 binary fixed point for the discount factor: multiplies renormalize
+// with a shift, and 62 fraction bits leave the payment exact to the cent
+using Fixed = unsigned __int128;
+constexpr int fixedBits = 62;
+constexpr Fixed fixedOne = Fixed(1) << fixedBits;
+
+Fixed fixedMultiply(Fixed a, Fixed b) {
+    return (a * b + (fixedOne >> 1)) >> fixedBits;
+}
+
+// What the limits buy: a row's balance times rate fits in 64 bits (the
+// balance can creep up a cent a month when the payment truncates), as does
+// the payment numerator in Q.62, and no running total can overflow
+constexpr std::int64_t maxPrincipalCents = static_cast<std::int64_t>(maxCentsPrincipal * 100);
+constexpr std::int64_t maxRateUnits = static_cast<std::int64_t>(maxCentsRate * rateUnitsPerPercent);
+static_assert(Fixed(maxPrincipalCents + maxTermMonths) * maxRateUnits <= ~std::uint64_t(0),
+              "row interest product must fit in 64 bits");
+static_assert(Fixed(maxPrincipalCents) * maxRateUnits < ~Fixed(0) / fixedOne, "payment numerator must fit");
+static_assert(Fixed(maxPrincipalCents) * maxRateUnits / monthlyRateDenominator * maxTermMonths
+                  < Fixed(1) << 62, "total interest must fit");
+
+std::int64_t toCents(double dollars) {
+    return std::llround(dollars * 100.0); // exact for values written by this engine
+}
+
+// Multiplying instead of dividing by 100 keeps the row loop off the divider;
+// the result is within an ulp of cents / 100, far inside half a cent, so
+// formatting and toCents() still recover the exact amount
+inline double toDollars(std::int64_t cents) {
+    return static_cast<double>(cents) * 0.01;
+}
+
+} // namespace
+
+template <Rounding R>
+std::int64_t levelPaymentCents(const LoanTerms &terms) {
+    const std::int64_t principal = Money<R>::fromDollars(terms.principal).cents();
+    const std::int64_t rate = rateUnits(terms);
+    if (rate <= 0)
+        return divideRounded<R, std::int64_t>(principal, terms.months);
+
+    // payment = P * r / (1 - v^n) with v = 1 / (1 + r), by squaring in fixed point
+    Fixed discount = divideRounded<Rounding::HalfEven, Fixed>(fixedOne * monthlyRateDenominator,
+                                                              Fixed(monthlyRateDenominator + rate));
+    Fixed power = fixedOne;
+    for (int n = terms.months; n > 0; n >>= 1) {
+        if (n & 1)
+            power = fixedMultiply(power, discount);
+        discount = fixedMultiply(discount, discount);
+    }
+    Fixed numerator = Fixed(principal) * Fixed(rate) * fixedOne;
+    Fixed denominator = Fixed(monthlyRateDenominator) * (fixedOne - power);
+    return static_cast<std::int64_t>(divideRounded<R, Fixed>(numerator, denominator));
+}
+
+namespace {
+
+// Rows firstRow..periods-1 from the checkpoint at firstRow - 1. Returns
+// false, leaving the rest of the schedule stale, if cancelled is set.
+template <Rounding R>
+bool fillCentsRows(const LoanTerms &terms, Schedule &schedule, int firstRow, const std::atomic<bool> *cancelled) {
+    const int months = schedule.periods;
+    if (firstRow < 0) firstRow = 0;
+    if (firstRow >= months)
+        return true;
+
+    const std::int64_t rate = rateUnits(terms);
+    const std::int64_t monthlyPayment = toCents(schedule.monthlyPayment);
+
+    double *payment = schedule.payment.data();
+    double *principal = schedule.principal.data();
+    double *interest = schedule.interest.data();
+    double *balance = schedule.balance.data();
+    double *cumPrincipal = schedule.cumulativePrincipal.data();
+    double *cumInterest = schedule.cumulativeInterest.data();
+    const double *prepayment = schedule.prepayment.data();
+
+    // Resume from the checkpoint left by the previous row
+    std::int64_t remaining = firstRow == 0 ? Money<R>::fromDollars(terms.principal).cents()
+                                           : toCents(balance[firstRow - 1]);
+    std::int64_t totalPrincipal = firstRow == 0 ? 0 : toCents(cumPrincipal[firstRow - 1]);
+    std::int64_t totalInterest = firstRow == 0 ? 0 : toCents(cumInterest[firstRow - 1]);
+    int paidOff = firstRow == 0 ? months : schedule.paidOffPeriod;
+
+    int i = firstRow;
+    if (remaining > 0) {
+        paidOff = months;
+        for (; i < months; ++i) {
+            if (cancelled && (i & 4095) == 0 && cancelled->load(std::memory_order_relaxed))
+                return false;
+
+            // Both factors are non-negative and their product fits (see the
+            // limits above), and unsigned division by the constant compiles
+            // to a multiply
+            std::int64_t rowInterest = static_cast<std::int64_t>(divideRounded<R, std::uint64_t>(
+                static_cast<std::uint64_t>(remaining) * static_cast<std::uint64_t>(rate), monthlyRateDenominator));
+            std::int64_t rowPrincipal = monthlyPayment - rowInterest;
+
+            // Last payment and early payoff both settle exactly the remaining balance
+            if (i == months - 1 || rowPrincipal > remaining)
+                rowPrincipal = remaining;
+
+            remaining -= rowPrincipal;
+            // A payment of the whole balance or more is not converted, so
+            // any amount is safe
+            if (prepayment[i] != 0.0)
+                remaining -= prepayment[i] * 100.0 >= remaining ? remaining : Money<R>::fromDollars(prepayment[i]).cents();
+            if (remaining < 0) remaining = 0;
+
+            totalPrincipal += rowPrincipal;
+            totalInterest += rowInterest;
+
+            payment[i] = toDollars(rowPrincipal + rowInterest);
+            principal[i] = toDollars(rowPrincipal);
+            interest[i] = toDollars(rowInterest);
+            balance[i] = toDollars(remaining);
+            cumPrincipal[i] = toDollars(totalPrincipal);
+            cumInterest[i] = toDollars(totalInterest);
+
+            if (remaining <= 0) {
+                paidOff = i + 1;
+                ++i;
+                break;
+            }
+        }
+    }
+
+    // Rows after an early payoff are zero; the running totals stay flat
+    std::fill(payment + i, payment + months, 0.0);
+    std::fill(principal + i, principal + months, 0.0);
+    std::fill(interest + i, interest + months, 0.0);
+    std::fill(balance + i, balance + months, 0.0);
+    std::fill(cumPrincipal + i, cumPrincipal + months, toDollars(totalPrincipal));
+    std::fill(cumInterest + i, cumInterest + months, toDollars(totalInterest));
+
+    schedule.paidOffPeriod = paidOff;
+    schedule.totalInterest = toDollars(totalInterest);
+    return true;
+}
+
+template <Rounding R>
+bool startCents(const LoanTerms &terms, Schedule &schedule, const std::atomic<bool> *cancelled) {
+    if (!isValid(terms) || !withinCentsLimits(terms))
+        return amortize(LoanTerms(), schedule); // empty, as for invalid terms
+
+    schedule.resize(terms.months);
+    schedule.monthlyPayment = toDollars(levelPaymentCents<R>(terms));
+    return fillCentsRows<R>(terms, schedule, 0, cancelled);
+}
+
+} // namespace
+
+template <Rounding R>
+bool amortizeCents(const LoanTerms &terms, Schedule &schedule) {
+    return startCents<R>(terms, schedule, nullptr);
+}
+
+template <Rounding R>
+bool amortizeCents(const LoanTerms &terms, Schedule &schedule, const std::atomic<bool> &cancelled) {
+    return startCents<R>(terms, schedule, &cancelled);
+}
+
+template <Rounding R>
+void amortizeCentsFrom(const LoanTerms &terms, Schedule &schedule, int firstRow) {
+    fillCentsRows<R>(terms, schedule, firstRow, nullptr);
+}
+
+
+template std::int64_t levelPaymentCents<Rounding::HalfEven>(const LoanTerms &);
+template std::int64_t levelPaymentCents<Rounding::HalfUp>(const LoanTerms &);
+template std::int64_t levelPaymentCents<Rounding::Truncate>(const LoanTerms &);
+template bool amortizeCents<Rounding::HalfEven>(const LoanTerms &, Schedule &);
+template bool amortizeCents<Rounding::HalfUp>(const LoanTerms &, Schedule &);
+template bool amortizeCents<Rounding::Truncate>(const LoanTerms &, Schedule &);
+template bool amortizeCents<Rounding::HalfEven>(const LoanTerms &, Schedule &, const std::atomic<bool> &);
+template bool amortizeCents<Rounding::HalfUp>(const LoanTerms &, Schedule &, const std::atomic<bool> &);
+template bool amortizeCents<Rounding::Truncate>(const LoanTerms &, Schedule &, const std::atomic<bool> &);
+template void amortizeCentsFrom<Rounding::HalfEven>(const LoanTerms &, Schedule &, int);
+template void amortizeCentsFrom<Rounding::HalfUp>(const LoanTerms &, Schedule &, int);
+template void amortizeCentsFrom<Rounding::Truncate>(const LoanTerms &, Schedule &, int);
+
+const char *arithmeticName(Arithmetic arithmetic) {
+    switch (arithmetic) {
+    case Arithmetic::Double: return "double";
+    case Arithmetic::CentsHalfEven: return "cents-half-even";
+    case Arithmetic::CentsHalfUp: return "cents-half-up";
+    case Arithmetic::CentsTruncate: return "cents-truncate";
+    }
+    return "unknown";
+}
+
+bool isValid(const LoanTerms &terms, Arithmetic arithmetic) {
+    return isValid(terms) && (arithmetic == Arithmetic::Double || withinCentsLimits(terms));
+}
+
+bool amortize(const LoanTerms &terms, Schedule &schedule, Arithmetic arithmetic) {
+    switch (arithmetic) {
+    case Arithmetic::CentsHalfEven: return amortizeCents<Rounding::HalfEven>(terms, schedule);
+    case Arithmetic::CentsHalfUp: return amortizeCents<Rounding::HalfUp>(terms, schedule);
+    case Arithmetic::CentsTruncate: return amortizeCents<Rounding::Truncate>(terms, schedule);
+    case Arithmetic::Double: break;
+    }
+    return amortize(terms, schedule);
+}
+
+bool amortize(const LoanTerms &terms, Schedule &schedule, Arithmetic arithmetic, const std::atomic<bool> &cancelled) {
+    switch (arithmetic) {
+    case Arithmetic::CentsHalfEven: return amortizeCents<Rounding::HalfEven>(terms, schedule, cancelled);
+    case Arithmetic::CentsHalfUp: return amortizeCents<Rounding::HalfUp>(terms, schedule, cancelled);
+    case Arithmetic::CentsTruncate: return amortizeCents<Rounding::Truncate>(terms, schedule, cancelled);
+    case Arithmetic::Double: break;
+    }
+    return amortize(terms, schedule, cancelled);
+}
+
+void amortizeFrom(const LoanTerms &terms, Schedule &schedule, int firstRow, Arithmetic arithmetic) {
+    switch (arithmetic) {
+    case Arithmetic::CentsHalfEven: amortizeCentsFrom<Rounding::HalfEven>(terms, schedule, firstRow); return;
+    case Arithmetic::CentsHalfUp: amortizeCentsFrom<Rounding::HalfUp>(terms, schedule, firstRow); return;
+    case Arithmetic::CentsTruncate: amortizeCentsFrom<Rounding::Truncate>(terms, schedule, firstRow); return;
+    case Arithmetic::Double: break;
+    }
+    amortizeFrom(terms, schedule, firstRow);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "amortizationEngine.h"
+#include "money.h"
+
+// Whole-cent amortization. Each row's interest is rounded to a cent under R,
+// principal is the payment less that interest, and the running totals are
+// exact sums, so displayed rows always add up to the totals. The rate is
+// taken to 1/10000 of a percent and the level payment is rounded to a cent.
+// Output goes to the same Schedule columns as the double engine (cents / 100).
+// Terms beyond the limits below are invalid here and give an empty schedule.
+template <Rounding R>
+bool amortizeCents(const LoanTerms &terms, Schedule &schedule);
+// As above, but gives up between blocks of rows once cancelled is set.
+template <Rounding R>
+bool amortizeCents(const LoanTerms &terms, Schedule &schedule, const std::atomic<bool> &cancelled);
+template <Rounding R>
+void amortizeCentsFrom(const LoanTerms &terms, Schedule &schedule, int firstRow);
+
+// Largest principal (dollars) and annual rate (percent) the cents engine
+// takes; with terms up to maxTermMonths every amount stays within 64 bits.
+constexpr double maxCentsPrincipal = 1e10;
+constexpr double maxCentsRate = 1000.0;
+
+// Level payment in cents, from integer arithmetic only. Terms must be
+// valid and within the limits above.
+template <Rounding R>
+std::int64_t levelPaymentCents(const LoanTerms &terms);
+
+// Engine choice at run time.
+enum class Arithmetic { Double, CentsHalfEven, CentsHalfUp, CentsTruncate };
+
+const char *arithmeticName(Arithmetic arithmetic);
+// isValid() for the chosen engine; the cents engines also apply their limits.
+bool isValid(const LoanTerms &terms, Arithmetic arithmetic);
+bool amortize(const LoanTerms &terms, Schedule &schedule, Arithmetic arithmetic);
+bool amortize(const LoanTerms &terms, Schedule &schedule, Arithmetic arithmetic, const std::atomic<bool> &cancelled);
+void amortizeFrom(const LoanTerms &terms, Schedule &schedule, int firstRow, Arithmetic arithmetic);
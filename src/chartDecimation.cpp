@@ -0,0 +1,49 @@
+#include "chartDecimation.h"
+#include <algorithm>
+
+QList<QPointF> decimateMinMax(const QList<QPointF> &points, double xMin, double xMax, int maxPoints) {
+    auto byX = [](const QPointF &p, double x) { return p.x() < x; };
+    qsizetype lo = std::lower_bound(points.cbegin(), points.cend(), xMin, byX) - points.cbegin();
+    qsizetype hi = std::lower_bound(points.cbegin(), points.cend(), xMax, byX) - points.cbegin();
+    lo = std::max<qsizetype>(0, lo - 1);
+    hi = std::min<qsizetype>(points.size(), hi + 1);
+
+    const qsizetype n = hi - lo;
+    if (n <= 0)
+        return QList<QPointF>();
+    if (n <= maxPoints)
+        return points.mid(lo, n);
+
+    // Two points per bucket plus the two range endpoints
+    const qsizetype buckets = std::max(1, (maxPoints - 2) / 2);
+    QList<QPointF> out;
+    out.reserve(buckets * 2 + 2);
+    out.append(points[lo]);
+    qsizetype lastIndex = lo;
+    for (qsizetype b = 0; b < buckets; ++b) {
+        qsizetype begin = lo + n * b / buckets;
+        qsizetype end = lo + n * (b + 1) / buckets;
+        if (begin >= end)
+            continue;
+        qsizetype minIndex = begin;
+        qsizetype maxIndex = begin;
+        for (qsizetype i = begin + 1; i < end; ++i) {
+            if (points[i].y() < points[minIndex].y()) minIndex = i;
+            if (points[i].y() > points[maxIndex].y()) maxIndex = i;
+        }
+        // Emit the pair in x order so the polyline does not fold back
+        qsizetype first = std::min(minIndex, maxIndex);
+        qsizetype second = std::max(minIndex, maxIndex);
+        if (first > lastIndex) {
+            out.append(points[first]);
+            lastIndex = first;
+        }
+        if (second > lastIndex) {
+            out.append(points[second]);
+            lastIndex = second;
+        }
+    }
+    if (hi - 1 > lastIndex)
+        out.append(points[hi - 1]);
+    return out;
+}
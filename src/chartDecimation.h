@@ -0,0 +1,11 @@
+#pragma once
+
+#include <QList>
+#include <QPointF>
+
+// Reduces points (sorted by x) to at most maxPoints for the x-range
+// [xMin, xMax]. Each bucket keeps its minimum and maximum, so peaks and the
+// overall shape survive; one point either side of the range is included to
+// keep lines running to the plot edge. Ranges already under the budget are
+// returned unchanged.
+QList<QPointF> decimateMinMax(const QList<QPointF> &points, double xMin, double xMax, int maxPoints);
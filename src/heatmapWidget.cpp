@@ -0,0 +1,120 @@
+#include "heatmapWidget.h"
+#include <QLocale>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Dark blue through green to yellow, readable without a legend for direction
+QRgb heatColor(double t) {
+    static const QColor stops[] = {
+        QColor(68, 1, 84), QColor(59, 82, 139), QColor(33, 145, 140), QColor(94, 201, 98), QColor(253, 231, 37)
+    };
+    const int last = int(std::size(stops)) - 1;
+    t = std::clamp(t, 0.0, 1.0) * last;
+    int i = std::min(int(t), last - 1);
+    double f = t - i;
+    const QColor &a = stops[i];
+    const QColor &b = stops[i + 1];
+    return qRgb(int(a.red() + (b.red() - a.red()) * f),
+                int(a.green() + (b.green() - a.green()) * f),
+                int(a.blue() + (b.blue() - a.blue()) * f));
+}
+
+} // namespace
+
+HeatmapWidget::HeatmapWidget(QWidget *parent) : QWidget(parent) {
+    setMouseTracking(true);
+    setMinimumHeight(220);
+}
+
+QSize HeatmapWidget::sizeHint() const {
+    return QSize(400, 300);
+}
+
+void HeatmapWidget::setGrid(const SensitivityGrid &newGrid) {
+    grid = newGrid;
+    const int rows = grid.rowCount();
+    const int cols = grid.columnCount();
+    if (rows == 0 || cols == 0) {
+        image = QImage();
+        update();
+        return;
+    }
+
+    auto [lo, hi] = std::minmax_element(grid.totalInterest.begin(), grid.totalInterest.end());
+    minInterest = *lo;
+    maxInterest = *hi;
+    const double span = maxInterest > minInterest ? maxInterest - minInterest : 1.0;
+
+    // One pixel per cell; the painter scales it to the widget
+    image = QImage(cols, rows, QImage::Format_RGB32);
+    for (int r = 0; r < rows; ++r) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(rows - 1 - r));
+        for (int c = 0; c < cols; ++c)
+            line[c] = heatColor((grid.totalInterest[std::size_t(r) * cols + c] - minInterest) / span);
+    }
+    update();
+}
+
+QRect HeatmapWidget::plotRect() const {
+    return rect().adjusted(60, 24, -12, -36);
+}
+
+QString HeatmapWidget::columnLabel(double value) const {
+    if (grid.columnAxis == SensitivityGrid::Term)
+        return QString("%1 mo").arg(int(value));
+    return QString("$%1").arg(QLocale::system().toString(value, 'f', 0));
+}
+
+void HeatmapWidget::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    const QRect plot = plotRect();
+    const QString axisName = grid.columnAxis == SensitivityGrid::Term ? "Term" : "Extra Monthly Payment";
+
+    if (image.isNull()) {
+        painter.drawText(rect(), Qt::AlignCenter, "Compute a sensitivity grid to see it here.");
+        return;
+    }
+
+    painter.drawText(QRect(0, 0, width(), 20), Qt::AlignCenter,
+                     QString("Total Interest by Rate and %1").arg(axisName));
+    painter.drawImage(plot, image);
+    painter.drawRect(plot.adjusted(0, 0, -1, -1));
+
+    // Axis extremes
+    painter.drawText(QRect(0, plot.top(), plot.left() - 4, 16), Qt::AlignRight,
+                     QString("%1%").arg(grid.rates.back(), 0, 'f', 2));
+    painter.drawText(QRect(0, plot.bottom() - 16, plot.left() - 4, 16), Qt::AlignRight,
+                     QString("%1%").arg(grid.rates.front(), 0, 'f', 2));
+    painter.drawText(QRect(plot.left(), plot.bottom() + 2, plot.width(), 16), Qt::AlignLeft,
+                     columnLabel(grid.columns.front()));
+    painter.drawText(QRect(plot.left(), plot.bottom() + 2, plot.width(), 16), Qt::AlignRight,
+                     columnLabel(grid.columns.back()));
+    painter.drawText(QRect(plot.left(), plot.bottom() + 18, plot.width(), 16), Qt::AlignCenter, axisName);
+}
+
+void HeatmapWidget::mouseMoveEvent(QMouseEvent *event) {
+    const QRect plot = plotRect();
+    const int rows = grid.rowCount();
+    const int cols = grid.columnCount();
+    if (image.isNull() || !plot.contains(event->position().toPoint())) {
+        QToolTip::hideText();
+        return;
+    }
+
+    int c = std::clamp(int((event->position().x() - plot.left()) * cols / plot.width()), 0, cols - 1);
+    int r = rows - 1 - std::clamp(int((event->position().y() - plot.top()) * rows / plot.height()), 0, rows - 1);
+    std::size_t cell = std::size_t(r) * cols + c;
+    QLocale locale = QLocale::system();
+    QString tip = QString("Rate: %1%\n%2: %3\nTotal Interest: $%4\nPaid Off: month %5")
+        .arg(grid.rates[r], 0, 'f', 3)
+        .arg(grid.columnAxis == SensitivityGrid::Term ? "Term" : "Extra")
+        .arg(columnLabel(grid.columns[c]))
+        .arg(locale.toString(grid.totalInterest[cell], 'f', 2))
+        .arg(grid.payoffMonth[cell]);
+    QToolTip::showText(event->globalPosition().toPoint(), tip, this);
+}
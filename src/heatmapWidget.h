@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QImage>
+#include <QWidget>
+#include "loanSolvers.h"
+
+// Paints a SensitivityGrid's total interest as a heatmap, rates increasing
+// upwards and the column axis to the right. Hovering a cell shows its values.
+class HeatmapWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit HeatmapWidget(QWidget *parent = nullptr);
+
+    void setGrid(const SensitivityGrid &grid);
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    QRect plotRect() const;
+    QString columnLabel(double value) const;
+
+    SensitivityGrid grid;
+    QImage image;
+    double minInterest = 0.0;
+    double maxInterest = 0.0;
+};
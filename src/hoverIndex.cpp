@@ -0,0 +1,42 @@
+#include "hoverIndex.h"
+#include <algorithm>
+#include <cmath>
+
+void HoverIndex::rebuild(const QRectF &plotArea, const QRectF &dataRange, const QList<QList<QPointF>> &series) {
+    this->plotArea = plotArea;
+    this->dataRange = dataRange;
+    this->series = series;
+    valid = true;
+}
+
+HoverIndex::Hit HoverIndex::nearest(const QPointF &position, double maxDistance) const {
+    Hit hit;
+    if (!valid || plotArea.width() <= 0 || plotArea.height() <= 0
+        || dataRange.width() <= 0 || dataRange.height() <= 0)
+        return hit;
+
+    // Linear axis transforms, equivalent to QChart::mapToPosition/mapToValue
+    const double xScale = plotArea.width() / dataRange.width();
+    const double yScale = plotArea.height() / dataRange.height();
+    const double cursorX = dataRange.left() + (position.x() - plotArea.left()) / xScale;
+    const double window = maxDistance / xScale;
+
+    auto byX = [](const QPointF &p, double x) { return p.x() < x; };
+    for (int s = 0; s < series.size(); ++s) {
+        const QList<QPointF> &points = series[s];
+        auto it = std::lower_bound(points.cbegin(), points.cend(), cursorX - window, byX);
+        for (; it != points.cend() && it->x() <= cursorX + window; ++it) {
+            double px = plotArea.left() + (it->x() - dataRange.left()) * xScale;
+            double py = plotArea.bottom() - (it->y() - dataRange.top()) * yScale;
+            double dist = std::hypot(px - position.x(), py - position.y());
+            if (dist < hit.distance) {
+                hit.series = s;
+                hit.point = *it;
+                hit.distance = dist;
+            }
+        }
+    }
+    if (hit.distance >= maxDistance)
+        return Hit();
+    return hit;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <limits>
+
+// Nearest-point lookup for line series whose x values increase
+// monotonically. rebuild() snapshots the points and the plot geometry; each
+// query then maps the cursor into data space once and binary-searches the
+// few points that can lie within range, instead of transforming every point.
+class HoverIndex {
+public:
+    struct Hit {
+        int series = -1; // index into the list passed to rebuild(), -1 for no hit
+        QPointF point;
+        double distance = std::numeric_limits<double>::max();
+    };
+
+    // plotArea is in the same coordinates as the query positions; dataRange
+    // holds the axis ranges (x: min..max, y: min..max).
+    void rebuild(const QRectF &plotArea, const QRectF &dataRange, const QList<QList<QPointF>> &series);
+    void invalidate() { valid = false; }
+    bool isValid() const { return valid; }
+
+    // Closest point to position across all series, if within maxDistance pixels.
+    Hit nearest(const QPointF &position, double maxDistance) const;
+
+private:
+    QRectF plotArea;
+    QRectF dataRange;
+    QList<QList<QPointF>> series;
+    bool valid = false;
+};
@@ -0,0 +1,152 @@
+#include "loanFile.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <type_traits>
+
+namespace {
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+// Splits off the text before the first sep, advancing s past it.
+std::string_view nextField(std::string_view &s, char sep) {
+    std::size_t pos = s.find(sep);
+    std::string_view field = s.substr(0, pos);
+    s = pos == std::string_view::npos ? std::string_view() : s.substr(pos + 1);
+    return trim(field);
+}
+
+template <typename T>
+bool parseNumber(std::string_view s, T &value) {
+    if (s.empty())
+        return false;
+    if (s.front() == '+')
+        s.remove_prefix(1);
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (result.ec != std::errc() || result.ptr != s.data() + s.size())
+        return false;
+    if constexpr (std::is_floating_point_v<T>)
+        return std::isfinite(value); // from_chars also reads "inf" and "nan"
+    return true;
+}
+
+} // namespace
+
+bool parseLoanLine(std::string_view line, LoanRecord &record) {
+    line = trim(line);
+    if (line.empty() || line.front() == '#')
+        return false;
+
+    double principal = 0.0;
+    double rate = 0.0;
+    double term = 0.0;
+    if (!parseNumber(nextField(line, ','), principal)
+        || !parseNumber(nextField(line, ','), rate)
+        || !parseNumber(nextField(line, ','), term))
+        return false;
+
+    std::string_view units = nextField(line, ',');
+    TermUnit unit;
+    if (!units.empty() && std::tolower(static_cast<unsigned char>(units.front())) == 'y')
+        unit = TermUnit::Years;
+    else if (!units.empty() && std::tolower(static_cast<unsigned char>(units.front())) == 'm')
+        unit = TermUnit::Months;
+    else
+        return false;
+
+    // A term too long to amortize is refused here rather than reported later
+    // as an invalid loan; a zero term still parses and is invalid
+    double months = unit == TermUnit::Years ? term * 12 : term;
+    if (!(months >= 0 && months <= maxTermMonths))
+        return false;
+
+    record.terms.principal = principal;
+    record.terms.annualRate = rate;
+    record.terms.months = termToMonths(term, unit);
+    record.prepayments.clear();
+
+    std::string_view events = trim(line);
+    while (!events.empty()) {
+        std::string_view event = nextField(events, ';');
+        if (event.empty())
+            continue;
+        Prepayment p;
+        // A negative payment would raise the balance in some engines and be
+        // ignored by others, so the line is refused instead
+        if (!parseNumber(nextField(event, ':'), p.month) || !parseNumber(trim(event), p.amount)
+            || p.month < 1 || !(p.amount > 0))
+            return false;
+        record.prepayments.push_back(p);
+    }
+    return true;
+}
+
+bool amortize(const LoanRecord &record, Schedule &schedule) {
+    if (!isValid(record.terms))
+        return amortize(record.terms, schedule);
+
+    schedule.resize(record.terms.months);
+    schedule.clearPrepayments();
+    for (const Prepayment &p : record.prepayments) {
+        if (p.month >= 1 && p.month <= record.terms.months)
+            schedule.prepayment[p.month - 1] += p.amount;
+    }
+    return amortize(record.terms, schedule);
+}
+
+LoanFileReader::~LoanFileReader() {
+    close();
+}
+
+bool LoanFileReader::open(const std::string &path) {
+    close();
+    file = std::fopen(path.c_str(), "rb");
+    carry.clear();
+    firstLine = nextLine = 1;
+    return file != nullptr;
+}
+
+void LoanFileReader::close() {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+bool LoanFileReader::readBlock(std::string &block, std::size_t targetBytes) {
+    block.swap(carry);
+    carry.clear();
+    if (!file && block.empty())
+        return false;
+
+    // Read until the block ends on a newline or the file runs out
+    while (file) {
+        std::size_t oldSize = block.size();
+        block.resize(oldSize + targetBytes);
+        std::size_t got = std::fread(&block[oldSize], 1, targetBytes, file);
+        block.resize(oldSize + got);
+        if (got < targetBytes) {
+            close();
+            break;
+        }
+        std::size_t lastNewline = block.rfind('\n');
+        if (lastNewline != std::string::npos && lastNewline >= oldSize) {
+            carry.assign(block, lastNewline + 1, std::string::npos);
+            block.resize(lastNewline + 1);
+            break;
+        }
+    }
+
+    firstLine = nextLine;
+    nextLine += std::count(block.begin(), block.end(), '\n');
+    if (!block.empty() && block.back() != '\n')
+        ++nextLine;
+    return !block.empty();
+}
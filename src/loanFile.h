@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "amortizationEngine.h"
+
+// Loan files hold one loan per line:
+//
+//   principal,rate,term,units[,month:amount;month:amount...]
+//
+// units is "years" or "months" (y/m also accepted) and the optional last
+// field lists one-time payments by 1-based month; amounts must be positive. Blank lines and lines
+// starting with '#' are ignored.
+
+struct Prepayment {
+    int month = 0; // 1-based
+    double amount = 0.0;
+};
+
+struct LoanRecord {
+    LoanTerms terms;
+    std::vector<Prepayment> prepayments;
+};
+
+// Parses one line into record, reusing its storage. Returns false for blank,
+// comment, header or malformed lines.
+bool parseLoanLine(std::string_view line, LoanRecord &record);
+
+// Loads record's prepayments into the schedule and amortizes it.
+bool amortize(const LoanRecord &record, Schedule &schedule);
+
+// Reads a loan file in blocks of whole lines, so the parsing itself can be
+// spread over worker threads.
+class LoanFileReader {
+public:
+    LoanFileReader() = default;
+    ~LoanFileReader();
+
+    LoanFileReader(const LoanFileReader &) = delete;
+    LoanFileReader &operator=(const LoanFileReader &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    // Replaces block with the next run of complete lines, roughly targetBytes
+    // long. Returns false once the file is exhausted.
+    bool readBlock(std::string &block, std::size_t targetBytes = 1 << 20);
+
+    // 1-based line number of the first line in the last block read.
+    long long blockFirstLine() const { return firstLine; }
+
+private:
+    std::FILE *file = nullptr;
+    std::string carry;
+    long long firstLine = 1;
+    long long nextLine = 1;
+};
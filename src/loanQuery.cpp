@@ -0,0 +1,135 @@
+#include "loanQuery.h"
+#include <algorithm>
+#include <cmath>
+
+LoanQuery::LoanQuery(const LoanTerms &terms, const std::vector<Prepayment> &prepayments)
+    : loanTerms(terms) {
+    valid = ::isValid(terms);
+    if (!valid)
+        return;
+
+    const int months = terms.months;
+    rate = terms.annualRate / 12.0 / 100.0;
+    logGrowth = std::log1p(rate);
+    payment = levelPayment(terms);
+
+    // Same-month payments add up, as they do in the schedule
+    for (const Prepayment &p : prepayments) {
+        if (p.month >= 1 && p.month <= months && p.amount != 0.0)
+            events.push_back(p);
+    }
+    std::sort(events.begin(), events.end(), [](const Prepayment &a, const Prepayment &b) { return a.month < b.month; });
+    std::size_t merged = 0;
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        if (merged > 0 && events[merged - 1].month == events[i].month)
+            events[merged - 1].amount += events[i].amount;
+        else
+            events[merged++] = events[i];
+    }
+    events.resize(merged);
+
+    Segment segment;
+    segment.balance = terms.principal;
+    std::size_t nextEvent = 0;
+    payoff = months;
+    for (;;) {
+        segment.end = nextEvent < events.size() ? events[nextEvent].month : months;
+
+        // Month at which a full payment would overshoot the balance:
+        // b*g^t - A*(g^t - 1)/r = 0  =>  t = -log(1 - r*b/A) / log(g)
+        double t = -std::log1p(-rate * segment.balance / payment) / logGrowth;
+        int overshoot = std::isfinite(t) ? segment.start + std::max(1, static_cast<int>(std::ceil(t - 1e-7)))
+                                         : months;
+        int settle = std::min(overshoot, months);
+        segment.settleMonth = settle <= segment.end ? settle : 0;
+        segments.push_back(segment);
+
+        if (segment.settleMonth) {
+            payoff = segment.settleMonth;
+            break;
+        }
+
+        State end = stateAt(segment, segment.end);
+        double balance = end.balance - events[nextEvent].amount;
+        if (balance <= 0) {
+            payoff = segment.end;
+            segments.back().settleMonth = 0;
+            break;
+        }
+        segment.start = segment.end;
+        segment.balance = balance;
+        segment.interest = end.interest;
+        segment.principal = end.principal;
+        ++nextEvent;
+    }
+}
+
+LoanQuery::State LoanQuery::stateAt(const Segment &s, int month) const {
+    // Regular payments for months start+1..k, where k stops short of settlement
+    int k = s.settleMonth && month >= s.settleMonth ? s.settleMonth - 1 : month;
+    int t = k - s.start;
+    double growth = std::expm1(t * logGrowth); // g^t - 1
+    double balance = s.balance + (s.balance * rate - payment) * growth / rate;
+    double paidDown = s.balance - balance;
+    State state{balance, s.interest + payment * t - paidDown, s.principal + paidDown};
+
+    if (s.settleMonth && month >= s.settleMonth) {
+        // The settling payment clears whatever is left
+        state.interest += state.balance * rate;
+        state.principal += state.balance;
+        state.balance = 0.0;
+    }
+    return state;
+}
+
+const LoanQuery::Segment &LoanQuery::segmentFor(int month) const {
+    auto it = std::upper_bound(segments.begin(), segments.end(), month,
+                               [](int m, const Segment &s) { return m <= s.start; });
+    return it == segments.begin() ? segments.front() : *(it - 1);
+}
+
+double LoanQuery::balanceAfter(int month) const {
+    if (!valid)
+        return 0.0;
+    if (month <= 0)
+        return loanTerms.principal;
+    if (month >= payoff)
+        return 0.0;
+    const Segment &s = segmentFor(month);
+    double balance = stateAt(s, month).balance;
+    // A one-time payment at the segment's last month is applied after the payment
+    if (month == s.end) {
+        auto event = std::lower_bound(events.begin(), events.end(), month,
+                                      [](const Prepayment &p, int m) { return p.month < m; });
+        if (event != events.end() && event->month == month)
+            balance -= event->amount;
+    }
+    return std::max(0.0, balance);
+}
+
+double LoanQuery::interestThrough(int month) const {
+    if (!valid || month <= 0)
+        return 0.0;
+    month = std::min(month, payoff);
+    return stateAt(segmentFor(month), month).interest;
+}
+
+double LoanQuery::principalThrough(int month) const {
+    if (!valid || month <= 0)
+        return 0.0;
+    month = std::min(month, payoff);
+    return stateAt(segmentFor(month), month).principal;
+}
+
+double LoanQuery::interestBetween(int firstMonth, int lastMonth) const {
+    if (lastMonth < firstMonth)
+        return 0.0;
+    return interestThrough(lastMonth) - interestThrough(firstMonth - 1);
+}
+
+bool LoanQuery::materialize(Schedule &schedule) const {
+    LoanRecord record;
+    record.terms = loanTerms;
+    record.prepayments = events;
+    return amortize(record, schedule);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include "amortizationEngine.h"
+#include "loanFile.h"
+
+// Answers point questions about a loan from the annuity closed form instead
+// of building its schedule. One-time payments split the loan into segments
+// of level payments, so construction is O(prepayments) and each query is a
+// binary search over segments plus O(1) arithmetic. Months are 1-based and
+// values agree with amortize() to floating-point rounding.
+class LoanQuery {
+public:
+    explicit LoanQuery(const LoanTerms &terms, const std::vector<Prepayment> &prepayments = {});
+
+    bool isValid() const { return valid; }
+    const LoanTerms &terms() const { return loanTerms; }
+    double monthlyPayment() const { return payment; }
+    int payoffMonth() const { return payoff; }
+    double totalInterest() const { return interestThrough(payoff); }
+
+    // Balance left after month's payment (and any one-time payment that month).
+    double balanceAfter(int month) const;
+    // Interest and scheduled principal paid in months 1..month.
+    double interestThrough(int month) const;
+    double principalThrough(int month) const;
+    // Interest paid in months firstMonth..lastMonth inclusive.
+    double interestBetween(int firstMonth, int lastMonth) const;
+
+    // Builds the full schedule, for callers that do need every row.
+    bool materialize(Schedule &schedule) const;
+
+private:
+    struct Segment {
+        int start = 0;         // months before the segment
+        int end = 0;           // last month in the segment
+        int settleMonth = 0;   // month the balance is settled, or 0 if it is not
+        double balance = 0.0;  // balance entering the segment
+        double interest = 0.0; // cumulative interest entering the segment
+        double principal = 0.0;
+    };
+
+    struct State {
+        double balance;
+        double interest;
+        double principal;
+    };
+
+    // Loan state after month within segment s, before that month's prepayment.
+    State stateAt(const Segment &s, int month) const;
+    const Segment &segmentFor(int month) const;
+
+    LoanTerms loanTerms;
+    std::vector<Prepayment> events; // merged and sorted by month
+    std::vector<Segment> segments;
+    double rate = 0.0;
+    double logGrowth = 0.0;
+    double payment = 0.0;
+    int payoff = 0;
+    bool valid = false;
+};
@@ -0,0 +1,124 @@
+#include "loanSolvers.h"
+#include "batchKernel.h"
+#include "threadPool.h"
+#include <cmath>
+#include <future>
+
+namespace {
+
+int payoffWithExtra(const LoanRecord &loan, double extraMonthly, Schedule &schedule) {
+    amortizeWithExtra(loan, extraMonthly, schedule);
+    return schedule.paidOffPeriod;
+}
+
+double interestAtRate(const LoanRecord &loan, double annualRate, Schedule &schedule) {
+    LoanRecord candidate = loan;
+    candidate.terms.annualRate = annualRate;
+    amortize(candidate, schedule);
+    return schedule.totalInterest;
+}
+
+} // namespace
+
+bool amortizeWithExtra(const LoanRecord &loan, double extraMonthly, Schedule &schedule) {
+    if (!isValid(loan.terms))
+        return amortize(loan.terms, schedule);
+    schedule.resize(loan.terms.months);
+    for (double &p : schedule.prepayment)
+        p = extraMonthly;
+    for (const Prepayment &p : loan.prepayments) {
+        if (p.month >= 1 && p.month <= loan.terms.months)
+            schedule.prepayment[p.month - 1] += p.amount;
+    }
+    return amortize(loan.terms, schedule);
+}
+
+bool solveExtraPayment(const LoanRecord &loan, int targetMonth, double &extraMonthly) {
+    if (!isValid(loan.terms) || targetMonth < 1)
+        return false;
+
+    Schedule schedule;
+    if (payoffWithExtra(loan, 0.0, schedule) <= targetMonth) {
+        extraMonthly = 0.0;
+        return true;
+    }
+
+    // Paying the whole principal in month 1 always works, so bisect below it
+    double lo = 0.0;
+    double hi = loan.terms.principal;
+    while (hi - lo > 0.001) {
+        double mid = 0.5 * (lo + hi);
+        if (payoffWithExtra(loan, mid, schedule) <= targetMonth)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    extraMonthly = std::ceil(hi * 100.0) / 100.0; // whole cents, rounded in the payer's favour
+    return true;
+}
+
+bool solveRateForInterest(const LoanRecord &loan, double targetInterest, double &annualRate) {
+    if (!isValid(loan.terms) || targetInterest <= 0)
+        return false;
+
+    Schedule schedule;
+    double lo = 1e-6;
+    double hi = 100.0;
+    if (targetInterest < interestAtRate(loan, lo, schedule) || targetInterest > interestAtRate(loan, hi, schedule))
+        return false;
+
+    // Total interest rises monotonically with the rate
+    for (int i = 0; i < 100 && hi - lo > 1e-9; ++i) {
+        double mid = 0.5 * (lo + hi);
+        if (interestAtRate(loan, mid, schedule) < targetInterest)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    annualRate = 0.5 * (lo + hi);
+    return true;
+}
+
+void evaluateGrid(const LoanRecord &loan, SensitivityGrid &grid, ThreadPool &pool) {
+    const int rows = grid.rowCount();
+    const int cols = grid.columnCount();
+    grid.totalInterest.assign(static_cast<std::size_t>(rows) * cols, 0.0);
+    grid.payoffMonth.assign(static_cast<std::size_t>(rows) * cols, 0);
+
+    auto evaluateRow = [&loan, &grid, cols](int row) {
+        double *interest = &grid.totalInterest[static_cast<std::size_t>(row) * cols];
+        int *payoff = &grid.payoffMonth[static_cast<std::size_t>(row) * cols];
+
+        if (grid.columnAxis == SensitivityGrid::Term) {
+            // One row of terms is a batch of independent loans for the SIMD kernel
+            thread_local std::vector<LoanRecord> records;
+            thread_local std::vector<LoanSummary> summaries;
+            records.assign(cols, loan);
+            for (int c = 0; c < cols; ++c) {
+                records[c].terms.annualRate = grid.rates[row];
+                records[c].terms.months = static_cast<int>(grid.columns[c]);
+            }
+            summarizeLoans(records.data(), cols, summaries);
+            for (int c = 0; c < cols; ++c) {
+                interest[c] = summaries[c].totalInterest;
+                payoff[c] = summaries[c].paidOffPeriod;
+            }
+        } else {
+            thread_local Schedule schedule;
+            LoanRecord candidate = loan;
+            candidate.terms.annualRate = grid.rates[row];
+            for (int c = 0; c < cols; ++c) {
+                amortizeWithExtra(candidate, grid.columns[c], schedule);
+                interest[c] = schedule.totalInterest;
+                payoff[c] = schedule.paidOffPeriod;
+            }
+        }
+    };
+
+    std::vector<std::future<void>> pending;
+    pending.reserve(rows);
+    for (int row = 0; row < rows; ++row)
+        pending.push_back(pool.submit([&evaluateRow, row]() { evaluateRow(row); }));
+    for (std::future<void> &f : pending)
+        f.get();
+}
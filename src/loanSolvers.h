@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include "amortizationEngine.h"
+#include "loanFile.h"
+
+class ThreadPool;
+
+// Amortizes loan with extraMonthly added to every month's payment on top of
+// its one-time payments.
+bool amortizeWithExtra(const LoanRecord &loan, double extraMonthly, Schedule &schedule);
+
+// Smallest extra monthly payment that pays loan off by targetMonth (1-based),
+// found by bisection over repeated schedule evaluations. Returns false if no
+// amount can.
+bool solveExtraPayment(const LoanRecord &loan, int targetMonth, double &extraMonthly);
+
+// Annual rate (percent) at which loan's total interest equals targetInterest,
+// the break-even point against an alternative costing that much. Returns
+// false if the target is outside what rates up to 100% can produce.
+bool solveRateForInterest(const LoanRecord &loan, double targetInterest, double &annualRate);
+
+// Total interest and payoff month over a grid of rates (rows) by terms or
+// extra monthly payments (columns); cells are stored row-major.
+struct SensitivityGrid {
+    enum Axis { Term, ExtraPayment };
+
+    Axis columnAxis = Term;
+    std::vector<double> rates;   // annual percent
+    std::vector<double> columns; // months for Term, dollars for ExtraPayment
+    std::vector<double> totalInterest;
+    std::vector<int> payoffMonth;
+
+    int rowCount() const { return static_cast<int>(rates.size()); }
+    int columnCount() const { return static_cast<int>(columns.size()); }
+};
+
+// Fills grid's cells for loan, whose rate (and term, on the Term axis) are
+// replaced by each cell's values. Rows are spread across the pool.
+void evaluateGrid(const LoanRecord &loan, SensitivityGrid &grid, ThreadPool &pool);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+// Fixed-point money in whole cents. The rounding mode is a template
+// parameter, so a kernel built on it commits to one policy at compile time
+// and every result is exact integer arithmetic, identical on any compiler.
+
+// How a result that falls between cents is settled. HalfUp rounds ties away
+// from zero; Truncate rounds toward zero.
+enum class Rounding { HalfEven, HalfUp, Truncate };
+
+// numerator / denominator rounded to an integer under R; denominator must be
+// positive and below half the type's range.
+template <Rounding R, typename Int>
+constexpr Int divideRounded(Int numerator, Int denominator) {
+    Int quotient = numerator / denominator;
+    if constexpr (R == Rounding::Truncate) {
+        return quotient;
+    } else {
+        Int remainder = numerator - quotient * denominator;
+        Int twice = 2 * remainder;
+        if constexpr (std::is_signed_v<Int>) {
+            if (numerator < 0) {
+                // Round the magnitude so negative amounts mirror positive ones
+                twice = -twice;
+                bool away = R == Rounding::HalfUp ? twice >= denominator
+                                                  : twice > denominator || (twice == denominator && (quotient & 1) != 0);
+                return quotient - Int(away);
+            }
+        }
+        bool away = R == Rounding::HalfUp ? twice >= denominator
+                                          : twice > denominator || (twice == denominator && (quotient & 1) != 0);
+        return quotient + Int(away);
+    }
+}
+
+// Nearest integer to value under R, for converting doubles at the edges.
+template <Rounding R>
+inline double roundToInteger(double value) {
+    if constexpr (R == Rounding::HalfEven)
+        return std::nearbyint(value); // assumes the default round-to-nearest mode
+    else if constexpr (R == Rounding::HalfUp)
+        return std::round(value);
+    else
+        return std::trunc(value);
+}
+
+template <Rounding R = Rounding::HalfEven>
+class Money {
+public:
+    constexpr Money() = default;
+
+    static constexpr Money fromCents(std::int64_t cents) { return Money(cents); }
+    static Money fromDollars(double dollars) {
+        return Money(static_cast<std::int64_t>(roundToInteger<R>(dollars * 100.0)));
+    }
+
+    constexpr std::int64_t cents() const { return value; }
+    double dollars() const { return value / 100.0; }
+
+    // this * numerator / denominator, rounded once under R; the product is
+    // held in 128 bits so it cannot overflow.
+    constexpr Money scaled(std::int64_t numerator, std::int64_t denominator) const {
+        return Money(static_cast<std::int64_t>(
+            divideRounded<R, __int128>(static_cast<__int128>(value) * numerator, denominator)));
+    }
+
+    constexpr Money operator+(Money other) const { return Money(value + other.value); }
+    constexpr Money operator-(Money other) const { return Money(value - other.value); }
+    constexpr Money &operator+=(Money other) { value += other.value; return *this; }
+    constexpr Money &operator-=(Money other) { value -= other.value; return *this; }
+    constexpr bool operator==(Money other) const { return value == other.value; }
+    constexpr bool operator!=(Money other) const { return value != other.value; }
+    constexpr bool operator<(Money other) const { return value < other.value; }
+    constexpr bool operator>(Money other) const { return value > other.value; }
+    constexpr bool operator<=(Money other) const { return value <= other.value; }
+    constexpr bool operator>=(Money other) const { return value >= other.value; }
+
+private:
+    constexpr explicit Money(std::int64_t cents) : value(cents) {}
+
+    std::int64_t value = 0;
+};
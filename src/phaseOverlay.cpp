@@ -0,0 +1,48 @@
+#include "phaseOverlay.h"
+#include "phaseTimer.h"
+#include <QFontDatabase>
+
+PhaseOverlay::PhaseOverlay(QWidget *parent) : QLabel(parent) {
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setStyleSheet("background-color: rgba(0, 0, 0, 170); color: white; padding: 6px;");
+    setAttribute(Qt::WA_TransparentForMouseEvents); // keep hover and zoom working underneath
+    setTextFormat(Qt::PlainText);
+    move(8, 8);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(500);
+    connect(refreshTimer, &QTimer::timeout, this, &PhaseOverlay::refresh);
+}
+
+void PhaseOverlay::refresh() {
+    QString text = QString("%1 %2 %3 %4 %5\n")
+                       .arg("phase", -22)
+                       .arg("count", 7)
+                       .arg("last ms", 9)
+                       .arg("avg ms", 9)
+                       .arg("p99 ms", 9);
+    for (const PhaseTimer::PhaseStats &phase : PhaseTimer::stats()) {
+        text += QString("%1 %2 %3 %4 %5\n")
+                    .arg(QString::fromStdString(phase.name), -22)
+                    .arg(phase.count, 7)
+                    .arg(phase.lastMs, 9, 'f', 3)
+                    .arg(phase.averageMs, 9, 'f', 3)
+                    .arg(phase.p99Ms, 9, 'f', 3);
+    }
+    if (!PhaseTimer::isEnabled())
+        text += "(timing is off)";
+    setText(text.trimmed());
+    adjustSize();
+    raise();
+}
+
+void PhaseOverlay::showEvent(QShowEvent *event) {
+    refresh();
+    refreshTimer->start();
+    QLabel::showEvent(event);
+}
+
+void PhaseOverlay::hideEvent(QHideEvent *event) {
+    refreshTimer->stop();
+    QLabel::hideEvent(event);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QLabel>
+#include <QTimer>
+
+// Semi-transparent table of PhaseTimer stats (last, average and p99 per
+// phase) floated over the top-left corner of its parent, refreshed while shown.
+class PhaseOverlay : public QLabel {
+    Q_OBJECT
+
+public:
+    explicit PhaseOverlay(QWidget *parent);
+
+    void refresh();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    QTimer *refreshTimer;
+};
@@ -0,0 +1,146 @@
+#include "phaseTimer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+namespace {
+
+// Power of two so a ticket maps to its slot with a mask
+constexpr std::uint64_t ringSize = 1 << 16;
+
+// Each field is atomic so a reader racing a writer sees a torn slot rather
+// than undefined behaviour; the sequence tells it to skip the slot
+struct Slot {
+    std::atomic<std::uint64_t> sequence{0}; // 2 * ticket + 1 while writing, + 2 once written
+    std::atomic<const char *> name{nullptr};
+    std::atomic<std::uint64_t> start{0};
+    std::atomic<std::uint64_t> end{0};
+    std::atomic<std::uint32_t> thread{0};
+};
+
+struct Ring {
+    std::atomic<std::uint64_t> head{0};    // next ticket
+    std::atomic<std::uint64_t> cleared{0}; // tickets before this were cleared
+    Slot slots[ringSize];
+};
+
+Ring &ring() {
+    static Ring instance;
+    return instance;
+}
+
+std::uint32_t threadNumber() {
+    static std::atomic<std::uint32_t> nextThread{1};
+    thread_local std::uint32_t number = nextThread.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+
+struct Event {
+    const char *name;
+    std::uint64_t start;
+    std::uint64_t end;
+    std::uint32_t thread;
+};
+
+// Consistent copy of the events still in the ring, oldest first
+std::vector<Event> snapshot() {
+    Ring &r = ring();
+    std::uint64_t head = r.head.load(std::memory_order_acquire);
+    std::uint64_t first = std::max(head > ringSize ? head - ringSize : 0, r.cleared.load(std::memory_order_acquire));
+    if (first > head)
+        first = head;
+    std::vector<Event> events;
+    events.reserve(head - first);
+    for (std::uint64_t ticket = first; ticket < head; ++ticket) {
+        Slot &slot = r.slots[ticket & (ringSize - 1)];
+        std::uint64_t written = 2 * ticket + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != written)
+            continue; // still being written, or already overwritten
+        Event event{slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+                    slot.end.load(std::memory_order_relaxed), slot.thread.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == written && event.name)
+            events.push_back(event);
+    }
+    return events;
+}
+
+void writeJsonString(std::FILE *out, const char *text) {
+    std::fputc('"', out);
+    for (const char *c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            std::fputc('\\', out);
+        std::fputc(*c, out);
+    }
+    std::fputc('"', out);
+}
+
+} // namespace
+
+std::atomic<bool> PhaseTimer::enabled{false};
+
+std::uint64_t PhaseTimer::now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void PhaseTimer::record(const char *name, std::uint64_t startNs, std::uint64_t endNs) {
+    Ring &r = ring();
+    std::uint64_t ticket = r.head.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = r.slots[ticket & (ringSize - 1)];
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(startNs, std::memory_order_relaxed);
+    slot.end.store(endNs, std::memory_order_relaxed);
+    slot.thread.store(threadNumber(), std::memory_order_relaxed);
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+void PhaseTimer::clear() {
+    Ring &r = ring();
+    r.cleared.store(r.head.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+std::vector<PhaseTimer::PhaseStats> PhaseTimer::stats() {
+    std::map<std::string, std::vector<std::uint64_t>> durations; // oldest first
+    for (const Event &event : snapshot())
+        durations[event.name].push_back(event.end - event.start);
+
+    std::vector<PhaseStats> result;
+    for (auto &[name, values] : durations) {
+        PhaseStats phase;
+        phase.name = name;
+        phase.count = static_cast<long long>(values.size());
+        phase.lastMs = values.back() * 1e-6;
+        double total = 0;
+        for (std::uint64_t value : values)
+            total += double(value);
+        phase.averageMs = total / values.size() * 1e-6;
+        std::size_t rank = std::min(values.size() - 1, values.size() * 99 / 100);
+        std::nth_element(values.begin(), values.begin() + rank, values.end());
+        phase.p99Ms = values[rank] * 1e-6;
+        result.push_back(std::move(phase));
+    }
+    return result;
+}
+
+bool PhaseTimer::writeChromeTrace(const std::string &path) {
+    std::FILE *out = std::fopen(path.c_str(), "w");
+    if (!out)
+        return false;
+    std::vector<Event> events = snapshot();
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        const Event &event = events[i];
+        std::fprintf(out, "{\"name\":");
+        writeJsonString(out, event.name);
+        // Complete events; timestamps are microseconds
+        std::fprintf(out, ",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                     event.thread, event.start * 1e-3, (event.end - event.start) * 1e-3,
+                     i + 1 < events.size() ? "," : "");
+    }
+    std::fprintf(out, "]}\n");
+    return std::fclose(out) == 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-phase timing probes. PHASE_SCOPE("name") times the rest of the
+// enclosing block into a fixed-size lock-free ring of recent events, which
+// can be summarized per phase or written as Chrome trace-event JSON (open it
+// in chrome://tracing or Perfetto). Probes cost one relaxed atomic load while
+// timing is disabled at run time, and nothing when the build turns them off
+// (AMORTIZATION_PHASE_TIMING=OFF). Names must be string literals.
+class PhaseTimer {
+public:
+    struct PhaseStats {
+        std::string name;
+        long long count = 0; // events still in the ring
+        double lastMs = 0;
+        double averageMs = 0;
+        double p99Ms = 0;
+    };
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+    // Nanoseconds since the first call.
+    static std::uint64_t now();
+    static void record(const char *name, std::uint64_t startNs, std::uint64_t endNs);
+
+    // Forgets every recorded event.
+    static void clear();
+    // One entry per phase over the events still in the ring, sorted by name.
+    static std::vector<PhaseStats> stats();
+    static bool writeChromeTrace(const std::string &path);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const char *name) {
+        if (PhaseTimer::isEnabled()) {
+            this->name = name;
+            start = PhaseTimer::now();
+        }
+    }
+    ~ScopedPhase() {
+        if (name)
+            PhaseTimer::record(name, start, PhaseTimer::now());
+    }
+
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+private:
+    const char *name = nullptr;
+    std::uint64_t start = 0;
+};
+
+#ifdef AMORTIZATION_PHASE_TIMING
+#define PHASE_CONCAT_INNER(a, b) a##b
+#define PHASE_CONCAT(a, b) PHASE_CONCAT_INNER(a, b)
+#define PHASE_SCOPE(name) ScopedPhase PHASE_CONCAT(phaseScope_, __LINE__)(name)
+#else
+#define PHASE_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,212 @@
+#include "portfolio.h"
+#include "batchKernel.h"
+#include "loanFile.h"
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+const std::size_t blockBytes = 256 << 10;
+const int loansPerGroup = 512; // one batch kernel block, resident in cache
+
+// Per-month sums over the loans of every block that used one slot.
+struct MonthlyTotals {
+    std::vector<double> principal;
+    std::vector<double> interest;
+    std::vector<double> balance;
+    std::vector<double> prepayment;
+    long long loans = 0;
+    long long skipped = 0;
+    double originalPrincipal = 0.0;
+
+    void grow(int months) {
+        if (static_cast<int>(principal.size()) >= months)
+            return;
+        for (std::vector<double> *column : {&principal, &interest, &balance, &prepayment})
+            column->resize(months, 0.0);
+    }
+
+    void add(const MonthlyTotals &other) {
+        grow(static_cast<int>(other.principal.size()));
+        for (std::size_t i = 0; i < other.principal.size(); ++i) {
+            principal[i] += other.principal[i];
+            interest[i] += other.interest[i];
+            balance[i] += other.balance[i];
+            prepayment[i] += other.prepayment[i];
+        }
+        loans += other.loans;
+        skipped += other.skipped;
+        originalPrincipal += other.originalPrincipal;
+    }
+};
+
+// Amortizes every loan in a block of lines and adds its rows to totals.
+void addBlock(const std::string &block, MonthlyTotals &totals) {
+    thread_local std::vector<LoanRecord> records;
+    thread_local std::vector<LoanTerms> terms;
+    thread_local LoanBatch batch;
+    thread_local std::vector<double> prepayment;
+    thread_local std::vector<double> balanceBefore;
+    thread_local std::vector<double> rowPayment, rowPrincipal, rowInterest, rowBalance;
+    struct Event {
+        int period;
+        int lane;
+        double amount;
+    };
+    thread_local std::vector<Event> events;
+
+    int count = 0;
+    std::string_view rest(block);
+    while (!rest.empty()) {
+        std::size_t end = rest.find('\n');
+        std::string_view text = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        if (records.size() <= static_cast<std::size_t>(count))
+            records.resize(count + 1);
+        if (parseLoanLine(text, records[count]))
+            ++count;
+    }
+
+    for (int first = 0; first < count; first += loansPerGroup) {
+        const int n = std::min(loansPerGroup, count - first);
+        const LoanRecord *group = records.data() + first;
+
+        terms.resize(n);
+        events.clear();
+        for (int i = 0; i < n; ++i) {
+            terms[i] = group[i].terms;
+            if (!isValid(terms[i])) {
+                ++totals.skipped;
+                continue;
+            }
+            ++totals.loans;
+            totals.originalPrincipal += terms[i].principal;
+            for (const Prepayment &p : group[i].prepayments) {
+                if (p.month >= 1 && p.month <= terms[i].months && p.amount > 0)
+                    events.push_back({p.month - 1, i, p.amount});
+            }
+        }
+        std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.period < b.period; });
+
+        batch.assign(terms.data(), n);
+        totals.grow(batch.periods);
+        prepayment.assign(batch.lanes, 0.0);
+        balanceBefore.resize(batch.lanes);
+        for (std::vector<double> *row : {&rowPayment, &rowPrincipal, &rowInterest, &rowBalance})
+            row->resize(batch.lanes);
+        BatchRows rows;
+        rows.payment = rowPayment.data();
+        rows.principal = rowPrincipal.data();
+        rows.interest = rowInterest.data();
+        rows.balance = rowBalance.data();
+
+        std::size_t nextEvent = 0;
+        for (int period = 0; period < batch.periods; ++period) {
+            std::size_t firstEvent = nextEvent;
+            for (; nextEvent < events.size() && events[nextEvent].period == period; ++nextEvent) {
+                const Event &e = events[nextEvent];
+                prepayment[e.lane] += e.amount;
+                balanceBefore[e.lane] = batch.balance[e.lane];
+            }
+            // Rows are only needed to see how much of a prepayment was applied
+            bool anyPrepayment = nextEvent > firstEvent;
+            BatchTotals sums;
+            stepLoanBatch(batch, period, anyPrepayment ? prepayment.data() : nullptr, anyPrepayment ? &rows : nullptr,
+                          &sums);
+
+            // What a prepayment actually took off the balance; a lane seen
+            // twice in one month is counted once
+            double applied = 0.0;
+            for (std::size_t e = firstEvent; e < nextEvent; ++e) {
+                int lane = events[e].lane;
+                if (prepayment[lane] == 0.0)
+                    continue;
+                if (balanceBefore[lane] > 0)
+                    applied += balanceBefore[lane] - rowPrincipal[lane] - rowBalance[lane];
+                prepayment[lane] = 0.0;
+            }
+
+            totals.principal[period] += sums.principal;
+            totals.interest[period] += sums.interest;
+            totals.balance[period] += sums.balance;
+            totals.prepayment[period] += applied;
+        }
+    }
+}
+
+} // namespace
+
+bool aggregatePortfolio(const std::string &path, ThreadPool &pool, PortfolioResult &result,
+                        const PortfolioProgress &progress) {
+    LoanFileReader reader;
+    if (!reader.open(path))
+        return false;
+
+    // Block n adds into slot n % slots. Waiting for the oldest block before
+    // submitting another means a slot's previous block has always finished.
+    const std::size_t slots = static_cast<std::size_t>(pool.size()) * 2;
+    std::vector<MonthlyTotals> totals(slots);
+    std::deque<std::future<void>> inFlight;
+    std::uint64_t bytesRead = 0;
+    std::size_t blockIndex = 0;
+    bool cancelled = false;
+
+    std::string block;
+    while (reader.readBlock(block, blockBytes)) {
+        bytesRead += block.size();
+        if (inFlight.size() >= slots) {
+            inFlight.front().get();
+            inFlight.pop_front();
+        }
+        MonthlyTotals *slot = &totals[blockIndex++ % slots];
+        inFlight.push_back(pool.submit([block = std::move(block), slot]() { addBlock(block, *slot); }));
+        block = std::string();
+        if (progress && !progress(bytesRead)) {
+            cancelled = true;
+            break;
+        }
+    }
+    for (std::future<void> &pending : inFlight)
+        pending.get();
+    if (cancelled)
+        return false;
+
+    // Tree reduction: each level adds disjoint pairs in parallel
+    for (std::size_t stride = 1; stride < slots; stride *= 2) {
+        std::vector<std::future<void>> level;
+        for (std::size_t i = 0; i + stride < slots; i += 2 * stride)
+            level.push_back(pool.submit([&totals, i, stride]() { totals[i].add(totals[i + stride]); }));
+        for (std::future<void> &pending : level)
+            pending.get();
+    }
+
+    const MonthlyTotals &sum = totals[0];
+    const int months = static_cast<int>(sum.principal.size());
+    Schedule &schedule = result.aggregate;
+    schedule.resize(months);
+    double cumPrincipal = 0.0;
+    double cumInterest = 0.0;
+    schedule.paidOffPeriod = 0;
+    for (int i = 0; i < months; ++i) {
+        schedule.payment[i] = sum.principal[i] + sum.interest[i];
+        schedule.principal[i] = sum.principal[i];
+        schedule.interest[i] = sum.interest[i];
+        schedule.balance[i] = sum.balance[i];
+        schedule.prepayment[i] = sum.prepayment[i];
+        cumPrincipal += sum.principal[i];
+        cumInterest += sum.interest[i];
+        schedule.cumulativePrincipal[i] = cumPrincipal;
+        schedule.cumulativeInterest[i] = cumInterest;
+        if (schedule.payment[i] > 0)
+            schedule.paidOffPeriod = i + 1; // the last loan's final payment
+    }
+    schedule.monthlyPayment = months > 0 ? schedule.payment[0] : 0.0;
+    schedule.totalInterest = cumInterest;
+    result.loans = sum.loans;
+    result.skipped = sum.skipped;
+    result.principal = sum.originalPrincipal;
+    return true;
+}
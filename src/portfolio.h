@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "amortizationEngine.h"
+#include "threadPool.h"
+
+// Month-by-month cash flows of a whole book of loans.
+struct PortfolioResult {
+    // Each column is the sum over every loan for that month, with month 1
+    // being every loan's first payment. prepayment holds the one-time
+    // payments actually applied, which stop once a loan is paid off.
+    Schedule aggregate;
+    long long loans = 0;
+    long long skipped = 0;  // lines with invalid terms
+    double principal = 0.0; // original principal of the whole book
+};
+
+// Called with the input bytes handed to workers so far; return false to cancel.
+using PortfolioProgress = std::function<bool(std::uint64_t bytesRead)>;
+
+// Aggregates every loan in a loan file (see loanFile.h). Blocks of lines are
+// amortized with the batch kernel on pool and summed into one running total
+// per block in flight; the totals are combined with a tree reduction at the
+// end. No loan's schedule is kept, so memory is the longest term times the
+// blocks in flight. Returns false if the file cannot be read or progress
+// cancelled.
+bool aggregatePortfolio(const std::string &path, ThreadPool &pool, PortfolioResult &result,
+                        const PortfolioProgress &progress = {});
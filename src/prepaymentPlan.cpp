@@ -0,0 +1,240 @@
+#include "prepaymentPlan.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <type_traits>
+#include <string_view>
+
+namespace {
+
+bool byMonth(const Prepayment &a, const Prepayment &b) {
+    return a.month < b.month;
+}
+
+// First month at or after from on which rule pays, or INT_MAX.
+int nextOccurrence(const PrepaymentRule &rule, int from) {
+    int month = rule.firstMonth;
+    if (month < from) {
+        long long steps = (static_cast<long long>(from) - month + rule.interval - 1) / rule.interval;
+        long long next = month + steps * rule.interval;
+        if (next > INT_MAX)
+            return INT_MAX;
+        month = static_cast<int>(next);
+    }
+    if (rule.lastMonth > 0 && month > rule.lastMonth)
+        return INT_MAX;
+    return month;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+template <typename T>
+bool parseNumber(std::string_view s, T &value) {
+    s = trim(s);
+    if (!s.empty() && s.front() == '+')
+        s.remove_prefix(1);
+    if (s.empty())
+        return false;
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (result.ec != std::errc() || result.ptr != s.data() + s.size())
+        return false;
+    if constexpr (std::is_floating_point_v<T>)
+        return std::isfinite(value);
+    return true;
+}
+
+// "month,amount" with ',', ':' or ';' between; thousands separators are not
+// accepted since ',' is a separator.
+bool parsePrepaymentLine(std::string_view line, Prepayment &payment) {
+    std::size_t sep = line.find_first_of(",:;");
+    if (sep == std::string_view::npos)
+        return false;
+    return parseNumber(line.substr(0, sep), payment.month) && parseNumber(line.substr(sep + 1), payment.amount);
+}
+
+} // namespace
+
+bool isValid(const PrepaymentRule &rule) {
+    return rule.firstMonth >= 1 && rule.interval >= 1 && rule.amount > 0
+        && (rule.lastMonth == 0 || rule.lastMonth >= rule.firstMonth);
+}
+
+PrepaymentPlan::Cursor::Cursor(const PrepaymentPlan &plan, int firstMonth, int lastMonth)
+    : plan(&plan), last(lastMonth) {
+    firstMonth = std::max(firstMonth, 1);
+    nextOneTime = std::lower_bound(plan.oneTime.begin(), plan.oneTime.end(), Prepayment{firstMonth, 0.0}, byMonth)
+                  - plan.oneTime.begin();
+    ruleNext.reserve(plan.recurring.size());
+    for (const PrepaymentRule &rule : plan.recurring)
+        ruleNext.push_back(nextOccurrence(rule, firstMonth));
+    advance();
+}
+
+void PrepaymentPlan::Cursor::next() {
+    if (!done())
+        advance();
+}
+
+// Each source is already past the month it last contributed to, so the next
+// month is simply the smallest pending one.
+void PrepaymentPlan::Cursor::advance() {
+    int month = INT_MAX;
+    if (nextOneTime < plan->oneTime.size())
+        month = plan->oneTime[nextOneTime].month;
+    for (int ruleMonth : ruleNext)
+        month = std::min(month, ruleMonth);
+
+    current = month > last ? INT_MAX : month;
+    total = 0.0;
+    if (done())
+        return;
+    if (nextOneTime < plan->oneTime.size() && plan->oneTime[nextOneTime].month == month)
+        total += plan->oneTime[nextOneTime++].amount;
+    for (std::size_t r = 0; r < ruleNext.size(); ++r) {
+        if (ruleNext[r] != month)
+            continue;
+        total += plan->recurring[r].amount;
+        ruleNext[r] = month > INT_MAX - plan->recurring[r].interval
+            ? INT_MAX : nextOccurrence(plan->recurring[r], month + 1);
+    }
+}
+
+void PrepaymentPlan::clear() {
+    oneTime.clear();
+    recurring.clear();
+}
+
+void PrepaymentPlan::setOneTime(int month, double amount) {
+    if (month < 1)
+        return;
+    auto it = std::lower_bound(oneTime.begin(), oneTime.end(), Prepayment{month, 0.0}, byMonth);
+    bool present = it != oneTime.end() && it->month == month;
+    if (amount > 0) {
+        if (present)
+            it->amount = amount;
+        else
+            oneTime.insert(it, Prepayment{month, amount});
+    } else if (present) {
+        oneTime.erase(it);
+    }
+}
+
+double PrepaymentPlan::oneTimeIn(int month) const {
+    auto it = std::lower_bound(oneTime.begin(), oneTime.end(), Prepayment{month, 0.0}, byMonth);
+    return it != oneTime.end() && it->month == month ? it->amount : 0.0;
+}
+
+void PrepaymentPlan::addOneTime(const std::vector<Prepayment> &payments) {
+    std::size_t existing = oneTime.size();
+    for (const Prepayment &p : payments) {
+        if (p.month >= 1 && p.amount > 0)
+            oneTime.push_back(p);
+    }
+    // Merge the sorted new run into the old one, then fold equal months
+    std::stable_sort(oneTime.begin() + existing, oneTime.end(), byMonth);
+    std::inplace_merge(oneTime.begin(), oneTime.begin() + existing, oneTime.end(), byMonth);
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < oneTime.size(); ++i) {
+        if (out > 0 && oneTime[out - 1].month == oneTime[i].month)
+            oneTime[out - 1].amount += oneTime[i].amount;
+        else
+            oneTime[out++] = oneTime[i];
+    }
+    oneTime.resize(out);
+}
+
+void PrepaymentPlan::addRule(const PrepaymentRule &rule) {
+    if (isValid(rule))
+        recurring.push_back(rule);
+}
+
+void PrepaymentPlan::removeRule(int index) {
+    if (index >= 0 && index < static_cast<int>(recurring.size()))
+        recurring.erase(recurring.begin() + index);
+}
+
+double PrepaymentPlan::recurringIn(int month) const {
+    double amount = 0.0;
+    for (const PrepaymentRule &rule : recurring) {
+        if (nextOccurrence(rule, month) == month)
+            amount += rule.amount;
+    }
+    return amount;
+}
+
+std::vector<Prepayment> PrepaymentPlan::events(int months) const {
+    std::vector<Prepayment> out;
+    for (Cursor cursor(*this, 1, months); !cursor.done(); cursor.next())
+        out.push_back({cursor.month(), cursor.amount()});
+    return out;
+}
+
+void PrepaymentPlan::fill(std::vector<double> &column, int firstRow) const {
+    const int rows = static_cast<int>(column.size());
+    firstRow = std::max(firstRow, 0);
+    if (firstRow >= rows)
+        return;
+    std::fill(column.begin() + firstRow, column.end(), 0.0);
+    for (Cursor cursor(*this, firstRow + 1, rows); !cursor.done(); cursor.next())
+        column[cursor.month() - 1] = cursor.amount();
+}
+
+bool importPrepayments(const std::string &path, PrepaymentPlan &plan, long long *skipped) {
+    LoanFileReader reader;
+    if (!reader.open(path))
+        return false;
+
+    // Collect everything first so the plan is sorted and merged only once
+    std::vector<Prepayment> payments;
+    long long bad = 0;
+    std::string block;
+    while (reader.readBlock(block)) {
+        std::string_view rest(block);
+        while (!rest.empty()) {
+            std::size_t end = rest.find('\n');
+            std::string_view line = trim(rest.substr(0, end));
+            rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+            if (line.empty() || line.front() == '#')
+                continue;
+            Prepayment payment;
+            if (parsePrepaymentLine(line, payment) && payment.month >= 1 && payment.amount > 0)
+                payments.push_back(payment);
+            else
+                ++bad;
+        }
+    }
+    plan.addOneTime(payments);
+    if (skipped)
+        *skipped = bad;
+    return true;
+}
+
+bool amortize(const LoanTerms &terms, const PrepaymentPlan &plan, Schedule &schedule, Arithmetic arithmetic) {
+    if (!isValid(terms))
+        return amortize(terms, schedule, arithmetic);
+    schedule.resize(terms.months);
+    plan.fill(schedule.prepayment);
+    return amortize(terms, schedule, arithmetic);
+}
+
+bool amortize(const LoanTerms &terms, const PrepaymentPlan &plan, Schedule &schedule, Arithmetic arithmetic,
+              const std::atomic<bool> &cancelled) {
+    if (!isValid(terms))
+        return amortize(terms, schedule, arithmetic);
+    schedule.resize(terms.months);
+    plan.fill(schedule.prepayment);
+    return amortize(terms, schedule, arithmetic, cancelled);
+}
+
+void amortizeFrom(const LoanTerms &terms, const PrepaymentPlan &plan, Schedule &schedule, int firstRow,
+                  Arithmetic arithmetic) {
+    plan.fill(schedule.prepayment, firstRow);
+    amortizeFrom(terms, schedule, firstRow, arithmetic);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <climits>
+#include <string>
+#include <vector>
+#include "amortizationEngine.h"
+#include "centsAmortization.h"
+#include "loanFile.h"
+
+// An extra payment repeated every interval months from firstMonth, e.g.
+// $200 every month from month 12, or a bonus every 12 months from the
+// first December. Months are 1-based; lastMonth 0 runs to the end.
+struct PrepaymentRule {
+    int firstMonth = 1;
+    int interval = 1;
+    int lastMonth = 0;
+    double amount = 0.0;
+};
+
+bool isValid(const PrepaymentRule &rule);
+
+// Extra payments kept sparse: one-time payments in a flat map sorted by
+// month, plus recurring rules that are only expanded when walked with a
+// Cursor. Rule and one-time payments falling in the same month add up.
+class PrepaymentPlan {
+public:
+    // Walks the months that have a payment, in order, merging the one-time
+    // payments with each rule's next occurrence. Each step costs O(rules).
+    class Cursor {
+    public:
+        Cursor(const PrepaymentPlan &plan, int firstMonth = 1, int lastMonth = INT_MAX);
+
+        bool done() const { return current == INT_MAX; }
+        int month() const { return current; }
+        double amount() const { return total; } // everything due in month()
+        void next();
+
+    private:
+        void advance();
+
+        const PrepaymentPlan *plan;
+        std::size_t nextOneTime = 0;
+        std::vector<int> ruleNext; // next month each rule pays, INT_MAX once finished
+        int last;
+        int current = 0;
+        double total = 0.0;
+    };
+
+    bool empty() const { return oneTime.empty() && recurring.empty(); }
+    void clear();
+
+    // Sets the one-time payment for month; 0 removes it.
+    void setOneTime(int month, double amount);
+    double oneTimeIn(int month) const;
+    const std::vector<Prepayment> &oneTimePayments() const { return oneTime; }
+    // Adds many one-time payments in one sort and merge; amounts for the
+    // same month add up. Invalid months and non-positive amounts are skipped.
+    void addOneTime(const std::vector<Prepayment> &payments);
+
+    void addRule(const PrepaymentRule &rule);
+    void removeRule(int index);
+    const std::vector<PrepaymentRule> &rules() const { return recurring; }
+    // Sum of the rules paying in month.
+    double recurringIn(int month) const;
+
+    // Every payment in months 1..months, rules expanded and merged.
+    std::vector<Prepayment> events(int months) const;
+    // Zeroes column from firstRow on and writes in the payments for those
+    // rows (row = month - 1), touching only rows that have one.
+    void fill(std::vector<double> &column, int firstRow = 0) const;
+
+private:
+    std::vector<Prepayment> oneTime; // sorted by month, one entry per month
+    std::vector<PrepaymentRule> recurring;
+};
+
+// Reads one-time payments from a text file, one "month,amount" per line
+// (':' or ';' also separate; blank lines and '#' comments are skipped).
+// Returns false if the file cannot be read; malformed lines and amounts that
+// are not positive are counted in *skipped when given.
+bool importPrepayments(const std::string &path, PrepaymentPlan &plan, long long *skipped = nullptr);
+
+// Amortizes terms with plan's payments written into schedule.prepayment.
+bool amortize(const LoanTerms &terms, const PrepaymentPlan &plan, Schedule &schedule,
+              Arithmetic arithmetic = Arithmetic::Double);
+// As above, but returns false part way through once cancelled is set.
+bool amortize(const LoanTerms &terms, const PrepaymentPlan &plan, Schedule &schedule, Arithmetic arithmetic,
+              const std::atomic<bool> &cancelled);
+// Recomputes rows firstRow on after plan changed at or after firstRow + 1.
+void amortizeFrom(const LoanTerms &terms, const PrepaymentPlan &plan, Schedule &schedule, int firstRow,
+                  Arithmetic arithmetic = Arithmetic::Double);
@@ -0,0 +1,87 @@
+#include "quantileSketch.h"
+#include <cmath>
+#include <cstring>
+
+// Buckets are equal steps of a piecewise-linear log2 (the exponent plus the
+// mantissa fraction), so the index is just the exponent and the leading
+// mantissa bits of a positive double.
+int QuantileSketch::bucketIndex(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return static_cast<int>(bits >> (52 - mantissaBits)) - (1023 << mantissaBits);
+}
+
+double QuantileSketch::bucketValue(int index) {
+    // Harmonic mean of the bounds balances the relative error at either end
+    int exponent = index >= 0 ? index / bucketsPerOctave : -((-index + bucketsPerOctave - 1) / bucketsPerOctave);
+    int step = index - exponent * bucketsPerOctave;
+    double lower = std::ldexp(1.0 + double(step) / bucketsPerOctave, exponent);
+    double upper = std::ldexp(1.0 + double(step + 1) / bucketsPerOctave, exponent);
+    return 2.0 * lower * upper / (lower + upper);
+}
+
+void QuantileSketch::grow(int firstNeeded, int lastNeeded) {
+    if (counts.empty()) {
+        firstIndex = firstNeeded;
+        counts.assign(lastNeeded - firstNeeded + 1, 0);
+        return;
+    }
+    if (firstNeeded < firstIndex) {
+        // Leave room below as well; values often drift down a bucket at a time
+        int extra = firstIndex - firstNeeded + bucketsPerOctave / 4;
+        counts.insert(counts.begin(), extra, 0);
+        firstIndex -= extra;
+    }
+    int lastIndex = firstIndex + static_cast<int>(counts.size()) - 1;
+    if (lastNeeded > lastIndex)
+        counts.resize(lastNeeded - firstIndex + 1, 0);
+}
+
+void QuantileSketch::add(double value) {
+    ++total;
+    if (!(value >= minValue)) {
+        ++zeroCount;
+        return;
+    }
+    int index = bucketIndex(value);
+    int offset = index - firstIndex;
+    if (offset < 0 || offset >= static_cast<int>(counts.size())) {
+        grow(index, index);
+        offset = index - firstIndex;
+    }
+    ++counts[offset];
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+    total += other.total;
+    zeroCount += other.zeroCount;
+    if (other.counts.empty())
+        return;
+    grow(other.firstIndex, other.firstIndex + static_cast<int>(other.counts.size()) - 1);
+    std::uint64_t *target = counts.data() + (other.firstIndex - firstIndex);
+    for (std::size_t i = 0; i < other.counts.size(); ++i)
+        target[i] += other.counts[i];
+}
+
+void QuantileSketch::clear() {
+    counts.clear();
+    firstIndex = 0;
+    zeroCount = 0;
+    total = 0;
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (total == 0)
+        return 0.0;
+    q = q < 0.0 ? 0.0 : (q > 1.0 ? 1.0 : q);
+    std::uint64_t rank = static_cast<std::uint64_t>(q * double(total - 1));
+    if (rank < zeroCount)
+        return 0.0;
+    std::uint64_t seen = zeroCount;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen > rank)
+            return bucketValue(firstIndex + static_cast<int>(i));
+    }
+    return bucketValue(firstIndex + static_cast<int>(counts.size()) - 1);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Streaming quantile sketch for non-negative amounts. Values land in
+// logarithmic buckets (as in DDSketch), so any quantile is within
+// relativeAccuracy of an actual value, memory grows with the range of values
+// rather than their number, and merging two sketches is exact.
+class QuantileSketch {
+public:
+    static constexpr int mantissaBits = 7;
+    static constexpr int bucketsPerOctave = 1 << mantissaBits;
+    static constexpr double relativeAccuracy = 1.0 / (2 * bucketsPerOctave);
+
+    // Values below minValue (by default half a cent) count as zero.
+    explicit QuantileSketch(double minValue = 0.005) : minValue(minValue) {}
+
+    void add(double value);
+    void merge(const QuantileSketch &other);
+    void clear();
+
+    std::uint64_t count() const { return total; }
+    // q in [0, 1]; 0 for an empty sketch
+    double quantile(double q) const;
+
+private:
+    static int bucketIndex(double value);
+    static double bucketValue(int index);
+    void grow(int firstNeeded, int lastNeeded);
+
+    double minValue;
+    std::vector<std::uint64_t> counts; // buckets firstIndex, firstIndex + 1, ...
+    int firstIndex = 0;
+    std::uint64_t zeroCount = 0;
+    std::uint64_t total = 0;
+};
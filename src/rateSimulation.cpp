@@ -0,0 +1,211 @@
+#include "rateSimulation.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <future>
+
+namespace {
+
+std::uint64_t splitMix64(std::uint64_t &state) {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** with a portable normal draw; std::normal_distribution output
+// differs between standard libraries, which would break reproducibility
+class RandomStream {
+public:
+    RandomStream(std::uint64_t seed, std::uint64_t stream) {
+        std::uint64_t state = seed ^ (stream * 0xd1b54a32d192ed03ull);
+        for (std::uint64_t &word : s)
+            word = splitMix64(state);
+    }
+
+    std::uint64_t next() {
+        std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+        std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform on (0, 1)
+    double uniform() { return (double(next() >> 11) + 0.5) * 0x1p-53; }
+
+    // Marsaglia's polar method, keeping the second value for the next call
+    double normal() {
+        if (haveSpare) {
+            haveSpare = false;
+            return spare;
+        }
+        double u, v, s;
+        do {
+            u = 2.0 * uniform() - 1.0;
+            v = 2.0 * uniform() - 1.0;
+            s = u * u + v * v;
+        } while (s >= 1.0);
+        double scale = std::sqrt(-2.0 * std::log(s) / s);
+        spare = v * scale;
+        haveSpare = true;
+        return u * scale;
+    }
+
+private:
+    static std::uint64_t rotl(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    std::uint64_t s[4];
+    double spare = 0.0;
+    bool haveSpare = false;
+};
+
+double paymentFor(double balance, double annualRate, int months) {
+    if (annualRate <= 0.0)
+        return balance / months;
+    return levelPayment({balance, annualRate, months});
+}
+
+struct BlockSketches {
+    std::vector<QuantileSketch> payment;
+    std::vector<QuantileSketch> balance;
+};
+
+BlockSketches simulateBlock(const ArmTerms &arm, const RateModel &model, std::uint64_t seed, long long block,
+                            long long paths) {
+    const int months = arm.loan.months;
+    BlockSketches sketches;
+    sketches.payment.resize(months);
+    sketches.balance.resize(months);
+    RandomStream random(seed, static_cast<std::uint64_t>(block));
+
+    const double initialRate = arm.loan.annualRate;
+    const double ceiling = initialRate + arm.lifetimeCap;
+    const double rateFloor = std::max(0.0, arm.floor);
+    const double kappa = model.reversionSpeed;
+
+    // Paths in a chunk step through the months together, which keeps their
+    // independent balance chains overlapping, and land in month-major
+    // buffers so each month's sketches stay in cache while the chunk is added
+    const int chunk = 64;
+    std::vector<double> payments(static_cast<std::size_t>(months) * chunk);
+    std::vector<double> balances(static_cast<std::size_t>(months) * chunk);
+    double rate[chunk], index[chunk], balance[chunk], payment[chunk], monthlyRate[chunk];
+
+    for (long long first = 0; first < paths; first += chunk) {
+        const int count = static_cast<int>(std::min<long long>(chunk, paths - first));
+        const double initialPayment = paymentFor(arm.loan.principal, initialRate, months);
+        for (int path = 0; path < count; ++path) {
+            rate[path] = initialRate;
+            index[path] = model.initialIndex;
+            balance[path] = arm.loan.principal;
+            payment[path] = initialPayment;
+            monthlyRate[path] = initialRate / 12.0 / 100.0;
+        }
+
+        int lastDraw = 0;
+        for (int m = 0; m < months; ++m) {
+            if (m >= arm.fixedMonths && (m - arm.fixedMonths) % arm.resetMonths == 0) {
+                // Exact Vasicek transition over the months since the last reset
+                double dt = (m - lastDraw) / 12.0;
+                double decay = std::exp(-kappa * dt);
+                double variance = kappa > 0.0 ? (1.0 - decay * decay) / (2.0 * kappa) : dt;
+                double spread = model.volatility * std::sqrt(variance);
+                lastDraw = m;
+                for (int path = 0; path < count; ++path) {
+                    index[path] = model.longRunIndex + (index[path] - model.longRunIndex) * decay
+                                  + spread * random.normal();
+                    double next = index[path] + arm.margin;
+                    next = std::clamp(next, rate[path] - arm.periodicCap, rate[path] + arm.periodicCap);
+                    next = std::clamp(next, rateFloor, std::max(rateFloor, ceiling));
+                    rate[path] = next;
+                    monthlyRate[path] = next / 12.0 / 100.0;
+                    payment[path] = balance[path] > 0.0 ? paymentFor(balance[path], next, months - m) : 0.0;
+                }
+            }
+
+            // Same per-row rule as amortizeFrom
+            const bool lastMonth = m == months - 1;
+            double *monthPayments = payments.data() + static_cast<std::size_t>(m) * chunk;
+            double *monthBalances = balances.data() + static_cast<std::size_t>(m) * chunk;
+            for (int path = 0; path < count; ++path) {
+                double interest = balance[path] * monthlyRate[path];
+                double principal = payment[path] - interest;
+                if (lastMonth || principal > balance[path])
+                    principal = balance[path];
+                double remaining = balance[path] - principal;
+                balance[path] = remaining < 0.0 ? 0.0 : remaining;
+                monthPayments[path] = principal + interest;
+                monthBalances[path] = balance[path];
+            }
+        }
+
+        for (int m = 0; m < months; ++m) {
+            const double *monthPayments = payments.data() + static_cast<std::size_t>(m) * chunk;
+            const double *monthBalances = balances.data() + static_cast<std::size_t>(m) * chunk;
+            for (int path = 0; path < count; ++path) {
+                sketches.payment[m].add(monthPayments[path]);
+                sketches.balance[m].add(monthBalances[path]);
+            }
+        }
+    }
+    return sketches;
+}
+
+} // namespace
+
+bool isValid(const ArmTerms &arm) {
+    return isValid(arm.loan) && arm.fixedMonths >= 0 && arm.resetMonths >= 1 && arm.periodicCap >= 0.0
+           && arm.lifetimeCap >= 0.0;
+}
+
+bool simulateArm(const ArmTerms &arm, const RateModel &model, const SimulationOptions &options, ThreadPool &pool,
+                 SimulationResult &result, const SimulationProgress &progress) {
+    result = SimulationResult();
+    if (!isValid(arm) || options.paths < 1)
+        return false;
+
+    const int months = arm.loan.months;
+    const long long blockPaths = std::max(1, options.pathsPerTask);
+    const long long blocks = (options.paths + blockPaths - 1) / blockPaths;
+    result.payment.resize(months);
+    result.balance.resize(months);
+
+    // Bound the sketches alive at once; merging is exact, so order is free
+    const std::size_t maxInFlight = 2 * static_cast<std::size_t>(pool.size());
+    std::deque<std::future<BlockSketches>> inFlight;
+    long long nextBlock = 0;
+    long long pathsDone = 0;
+    bool cancelled = false;
+
+    while (nextBlock < blocks || !inFlight.empty()) {
+        while (!cancelled && nextBlock < blocks && inFlight.size() < maxInFlight) {
+            long long first = nextBlock * blockPaths;
+            long long paths = std::min(blockPaths, options.paths - first);
+            inFlight.push_back(pool.submit([&arm, &model, seed = options.seed, block = nextBlock, paths]() {
+                return simulateBlock(arm, model, seed, block, paths);
+            }));
+            ++nextBlock;
+        }
+        if (inFlight.empty())
+            break;
+
+        BlockSketches sketches = inFlight.front().get();
+        inFlight.pop_front();
+        for (int m = 0; m < months; ++m) {
+            result.payment[m].merge(sketches.payment[m]);
+            result.balance[m].merge(sketches.balance[m]);
+        }
+        pathsDone += static_cast<long long>(sketches.payment.empty() ? 0 : sketches.payment[0].count());
+        if (!cancelled && progress && !progress(pathsDone, options.paths))
+            cancelled = true; // drain what is running, start nothing new
+    }
+
+    result.paths = pathsDone;
+    return !cancelled;
+}
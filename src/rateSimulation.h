@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "amortizationEngine.h"
+#include "quantileSketch.h"
+
+class ThreadPool;
+
+// Adjustable-rate loan: loan.annualRate holds for fixedMonths, then the rate
+// resets every resetMonths to the index plus margin, limited by the caps, and
+// the payment is re-amortized over the remaining term.
+struct ArmTerms {
+    LoanTerms loan;
+    int fixedMonths = 60;
+    int resetMonths = 12;
+    double margin = 2.75;      // percentage points over the index
+    double periodicCap = 2.0;  // largest change at one reset
+    double lifetimeCap = 5.0;  // largest rise over the initial rate
+    double floor = 0.0;        // lowest rate after a reset
+};
+
+// Mean-reverting (Vasicek) index rate in annual percent, sampled exactly at
+// each reset rather than stepped month by month.
+struct RateModel {
+    double initialIndex = 4.0;
+    double longRunIndex = 4.0;
+    double reversionSpeed = 0.25; // per year
+    double volatility = 1.0;      // percentage points per square root of a year
+};
+
+struct SimulationOptions {
+    long long paths = 100000;
+    std::uint64_t seed = 1;
+    int pathsPerTask = 4096;
+};
+
+// Per-month payment and end-of-month balance distributions over every path.
+struct SimulationResult {
+    long long paths = 0;
+    std::vector<QuantileSketch> payment;
+    std::vector<QuantileSketch> balance;
+
+    int months() const { return static_cast<int>(payment.size()); }
+};
+
+// Called between blocks of paths; return false to cancel.
+using SimulationProgress = std::function<bool(long long pathsDone, long long paths)>;
+
+bool isValid(const ArmTerms &arm);
+
+// Simulates options.paths rate paths for arm across pool. Each block of
+// paths draws from its own random stream seeded by (seed, block), so results
+// do not depend on the thread count or scheduling, and is folded into
+// per-block sketches before merging, so memory is bounded by the term and the
+// blocks in flight rather than the path count. Returns false if arm is invalid
+// or progress cancelled.
+bool simulateArm(const ArmTerms &arm, const RateModel &model, const SimulationOptions &options, ThreadPool &pool,
+                 SimulationResult &result, const SimulationProgress &progress = {});
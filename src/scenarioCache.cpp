@@ -0,0 +1,123 @@
+#include "scenarioCache.h"
+#include <cstring>
+
+namespace {
+
+std::uint64_t mix(std::uint64_t hash, std::uint64_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+std::uint64_t bitsOf(double value) {
+    if (value == 0.0)
+        value = 0.0; // -0.0 compares equal, so it must hash equal
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+std::size_t scheduleBytes(const Schedule &schedule) {
+    std::size_t doubles = schedule.payment.capacity() + schedule.principal.capacity()
+                          + schedule.interest.capacity() + schedule.balance.capacity()
+                          + schedule.prepayment.capacity() + schedule.cumulativePrincipal.capacity()
+                          + schedule.cumulativeInterest.capacity();
+    return sizeof(Schedule) + doubles * sizeof(double);
+}
+
+} // namespace
+
+ScenarioKey ScenarioKey::make(const LoanTerms &terms, bool inYears, Arithmetic arithmetic,
+                              const std::vector<Prepayment> &payments) {
+    ScenarioKey key;
+    key.terms = terms;
+    key.inYears = inYears;
+    key.arithmetic = arithmetic;
+    for (const Prepayment &p : payments) {
+        if (p.month >= 1 && p.month <= terms.months && p.amount != 0.0)
+            key.prepayments.push_back(p);
+    }
+    return key;
+}
+
+void ScenarioKey::loadPrepayments(Schedule &schedule) const {
+    schedule.prepayment.assign(terms.months > 0 ? terms.months : 0, 0.0);
+    for (const Prepayment &p : prepayments) {
+        if (p.month >= 1 && p.month <= terms.months)
+            schedule.prepayment[p.month - 1] = p.amount;
+    }
+}
+
+// inYears is left out on purpose: it only changes how the schedule is shown
+bool operator==(const ScenarioKey &a, const ScenarioKey &b) {
+    if (a.terms != b.terms || a.arithmetic != b.arithmetic || a.prepayments.size() != b.prepayments.size())
+        return false;
+    for (std::size_t i = 0; i < a.prepayments.size(); ++i) {
+        if (a.prepayments[i].month != b.prepayments[i].month || a.prepayments[i].amount != b.prepayments[i].amount)
+            return false;
+    }
+    return true;
+}
+
+std::size_t ScenarioKeyHash::operator()(const ScenarioKey &key) const {
+    std::uint64_t hash = bitsOf(key.terms.principal);
+    hash = mix(hash, bitsOf(key.terms.annualRate));
+    hash = mix(hash, static_cast<std::uint64_t>(key.terms.months));
+    hash = mix(hash, static_cast<std::uint64_t>(key.arithmetic));
+    for (const Prepayment &p : key.prepayments) {
+        hash = mix(hash, static_cast<std::uint64_t>(p.month));
+        hash = mix(hash, bitsOf(p.amount));
+    }
+    return static_cast<std::size_t>(hash);
+}
+
+std::shared_ptr<const Schedule> ScenarioCache::find(const ScenarioKey &key) {
+    auto found = index.find(key);
+    if (found == index.end()) {
+        ++stats.misses;
+        return nullptr;
+    }
+    ++stats.hits;
+    entries.splice(entries.begin(), entries, found->second);
+    return found->second->schedule;
+}
+
+void ScenarioCache::insert(const ScenarioKey &key, std::shared_ptr<const Schedule> schedule) {
+    if (!schedule)
+        return;
+    std::size_t bytes = scheduleBytes(*schedule) + sizeof(Entry)
+                        + key.prepayments.capacity() * sizeof(Prepayment);
+    auto found = index.find(key);
+    if (found != index.end()) {
+        used -= found->second->bytes;
+        entries.erase(found->second);
+        index.erase(found);
+    }
+    if (bytes > budget)
+        return;
+
+    entries.push_front({key, std::move(schedule), bytes});
+    index.emplace(entries.front().key, entries.begin());
+    used += bytes;
+    evictToBudget();
+}
+
+void ScenarioCache::clear() {
+    entries.clear();
+    index.clear();
+    used = 0;
+}
+
+void ScenarioCache::setByteBudget(std::size_t bytes) {
+    budget = bytes;
+    evictToBudget();
+}
+
+void ScenarioCache::evictToBudget() {
+    while (used > budget && !entries.empty()) {
+        Entry &last = entries.back();
+        used -= last.bytes;
+        index.erase(last.key);
+        entries.pop_back();
+        ++stats.evictions;
+    }
+}
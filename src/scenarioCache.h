@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "amortizationEngine.h"
+#include "centsAmortization.h"
+#include "loanFile.h"
+
+// Everything a computed schedule depends on. The display unit is part of
+// the scenario, but two keys differing only in it share the same schedule.
+struct ScenarioKey {
+    LoanTerms terms;
+    bool inYears = false;
+    Arithmetic arithmetic = Arithmetic::Double;
+    std::vector<Prepayment> prepayments; // ascending months, non-zero amounts within the term
+
+    // Key for the schedule the inputs would produce; payments are sorted by
+    // month, as from PrepaymentPlan::events().
+    static ScenarioKey make(const LoanTerms &terms, bool inYears, Arithmetic arithmetic,
+                            const std::vector<Prepayment> &payments);
+
+    // Writes prepayments into schedule.prepayment, sized for the term.
+    void loadPrepayments(Schedule &schedule) const;
+};
+
+bool operator==(const ScenarioKey &a, const ScenarioKey &b);
+
+struct ScenarioKeyHash {
+    std::size_t operator()(const ScenarioKey &key) const;
+};
+
+// Bounded LRU of computed schedules. Entries are evicted least recently
+// used first once their estimated size exceeds the byte budget; a schedule
+// larger than the whole budget is not kept. Not thread-safe.
+class ScenarioCache {
+public:
+    struct Counters {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    explicit ScenarioCache(std::size_t byteBudget = 64 << 20) : budget(byteBudget) {}
+
+    // The cached schedule for key, or null; either way counted.
+    std::shared_ptr<const Schedule> find(const ScenarioKey &key);
+    void insert(const ScenarioKey &key, std::shared_ptr<const Schedule> schedule);
+    void clear();
+
+    void setByteBudget(std::size_t bytes);
+    std::size_t byteBudget() const { return budget; }
+    std::size_t bytesUsed() const { return used; }
+    std::size_t size() const { return entries.size(); }
+    const Counters &counters() const { return stats; }
+
+private:
+    struct Entry {
+        ScenarioKey key;
+        std::shared_ptr<const Schedule> schedule;
+        std::size_t bytes;
+    };
+
+    void evictToBudget();
+
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<ScenarioKey, std::list<Entry>::iterator, ScenarioKeyHash> index;
+    std::size_t budget;
+    std::size_t used = 0;
+    Counters stats;
+};
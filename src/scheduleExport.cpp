@@ -0,0 +1,139 @@
+#include "scheduleExport.h"
+#include "phaseTimer.h"
+#include <charconv>
+
+void appendInt(std::string &out, long long value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+void appendMoney(std::string &out, double value) {
+    char buf[64];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed, 2);
+    out.append(buf, result.ptr);
+}
+
+CsvWriter::CsvWriter(std::size_t flushBytes) : flushBytes(flushBytes) {
+    buffer.reserve(flushBytes + 4096);
+}
+
+CsvWriter::~CsvWriter() {
+    close();
+}
+
+bool CsvWriter::open(const std::string &path) {
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    failed = file == nullptr;
+    return file != nullptr;
+}
+
+bool CsvWriter::close() {
+    if (file) {
+        flush();
+        if (std::fclose(file) != 0)
+            failed = true;
+        file = nullptr;
+    }
+    buffer.clear();
+    return !failed;
+}
+
+void CsvWriter::separate() {
+    if (rowStarted)
+        buffer += ',';
+    rowStarted = true;
+}
+
+void CsvWriter::addText(std::string_view text) {
+    separate();
+    buffer.append(text);
+}
+
+void CsvWriter::addInt(long long value) {
+    separate();
+    appendInt(buffer, value);
+}
+
+void CsvWriter::addMoney(double value) {
+    separate();
+    appendMoney(buffer, value);
+}
+
+void CsvWriter::addEmpty() {
+    separate();
+}
+
+void CsvWriter::endRow() {
+    buffer += '\n';
+    rowStarted = false;
+    if (buffer.size() >= flushBytes)
+        flush();
+}
+
+void CsvWriter::flush() {
+    PHASE_SCOPE("export/flush");
+    if (file && !buffer.empty()) {
+        if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+            failed = true;
+    }
+    buffer.clear();
+}
+
+ExportStatus exportSchedulesCsv(const std::string &path, const std::vector<const Schedule *> &schedules,
+                                const ExportProgress &progress) {
+    CsvWriter writer;
+    if (!writer.open(path))
+        return ExportStatus::Failed;
+
+    const bool multiple = schedules.size() > 1;
+    long long total = 0;
+    for (const Schedule *schedule : schedules)
+        total += schedule->periods;
+
+    if (multiple)
+        writer.addText("Loan");
+    for (const char *header : {"Payment #", "Payment", "Principal", "Interest", "Balance", "One-Time Payment"})
+        writer.addText(header);
+    writer.endRow();
+
+    const long long reportEvery = 16384;
+    long long done = 0;
+    for (std::size_t s = 0; s < schedules.size(); ++s) {
+        const Schedule &schedule = *schedules[s];
+        for (int i = 0; i < schedule.periods; ++i) {
+            if (multiple)
+                writer.addInt(static_cast<long long>(s) + 1);
+            writer.addInt(i + 1);
+            writer.addMoney(schedule.payment[i]);
+            writer.addMoney(schedule.principal[i]);
+            writer.addMoney(schedule.interest[i]);
+            writer.addMoney(schedule.balance[i]);
+            // Blank, as in the table, unless a one-time payment was made
+            if (schedule.prepayment[i] != 0.0)
+                writer.addMoney(schedule.prepayment[i]);
+            else
+                writer.addEmpty();
+            writer.endRow();
+
+            // Also reported after each loan, so many short schedules still
+            // move the progress bar
+            ++done;
+            bool report = done % reportEvery == 0 || (multiple && i + 1 == schedule.periods);
+            if (progress && report && !progress(done, total)) {
+                writer.close();
+                std::remove(path.c_str());
+                return ExportStatus::Cancelled;
+            }
+        }
+    }
+
+    if (!writer.close()) {
+        std::remove(path.c_str());
+        return ExportStatus::Failed;
+    }
+    if (progress)
+        progress(total, total);
+    return ExportStatus::Ok;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "amortizationEngine.h"
+
+// Fast text formatting for exports, built on std::to_chars.
+void appendInt(std::string &out, long long value);
+void appendMoney(std::string &out, double value); // fixed, two decimals
+
+// CSV writer that formats straight into a large buffer and writes it out in
+// big blocks, so exporting is bound by I/O rather than formatting.
+class CsvWriter {
+public:
+    explicit CsvWriter(std::size_t flushBytes = 4 << 20);
+    ~CsvWriter();
+
+    CsvWriter(const CsvWriter &) = delete;
+    CsvWriter &operator=(const CsvWriter &) = delete;
+
+    bool open(const std::string &path);
+    // Flushes and closes the file; returns false if any write failed.
+    bool close();
+
+    void addText(std::string_view text);
+    void addInt(long long value);
+    void addMoney(double value);
+    void addEmpty();
+    void endRow();
+
+private:
+    void separate();
+    void flush();
+
+    std::FILE *file = nullptr;
+    std::string buffer;
+    std::size_t flushBytes;
+    bool rowStarted = false;
+    bool failed = false;
+};
+
+enum class ExportStatus { Ok, Cancelled, Failed };
+
+// Called every few thousand rows with rows written so far and the total.
+// Returning false cancels the export.
+using ExportProgress = std::function<bool(long long done, long long total)>;
+
+// Writes the schedules to one CSV file with the same columns as the table.
+// With more than one schedule a leading Loan column (1-based) tells them
+// apart. A cancelled or failed export removes the partial file.
+ExportStatus exportSchedulesCsv(const std::string &path, const std::vector<const Schedule *> &schedules,
+                                const ExportProgress &progress = ExportProgress());
@@ -0,0 +1,274 @@
+#include "scheduleFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char fileMagic[8] = {'A', 'M', 'S', 'C', 'H', 'E', 'D', '1'};
+const std::uint32_t fileVersion = 1;
+const std::uint32_t byteOrderMark = 0x01020304;
+const int columnCount = static_cast<int>(ScheduleColumn::Count);
+const std::size_t stagingRows = 1 << 16;
+
+std::uint64_t alignUp(std::uint64_t offset) {
+    return (offset + 63) & ~std::uint64_t(63);
+}
+
+// Header with the section offsets for a file of the given size; returns the
+// total file size through fileSize.
+ScheduleFileHeader makeHeader(std::uint64_t loanCount, std::uint64_t rowCount, std::uint64_t &fileSize) {
+    ScheduleFileHeader header{};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.byteOrder = byteOrderMark;
+    header.columnCount = columnCount;
+    header.loanCount = loanCount;
+    header.rowCount = rowCount;
+    header.indexOffset = alignUp(sizeof(ScheduleFileHeader));
+    std::uint64_t offset = alignUp(header.indexOffset + loanCount * sizeof(ScheduleFileEntry));
+    for (int c = 0; c < columnCount; ++c) {
+        header.columnOffset[c] = offset;
+        offset = alignUp(offset + rowCount * sizeof(double));
+    }
+    fileSize = offset;
+    return header;
+}
+
+ScheduleFileEntry makeEntry(const LoanTerms &terms, const Schedule &schedule, std::uint64_t firstRow) {
+    ScheduleFileEntry entry{};
+    entry.firstRow = firstRow;
+    entry.periods = schedule.periods;
+    entry.paidOffPeriod = schedule.paidOffPeriod;
+    entry.principal = terms.principal;
+    entry.annualRate = terms.annualRate;
+    entry.months = terms.months;
+    entry.monthlyPayment = schedule.monthlyPayment;
+    entry.totalInterest = schedule.totalInterest;
+    return entry;
+}
+
+bool writeAt(int fd, const void *data, std::size_t size, std::uint64_t offset) {
+    const char *p = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (written <= 0)
+            return false;
+        p += written;
+        size -= static_cast<std::size_t>(written);
+        offset += static_cast<std::uint64_t>(written);
+    }
+    return true;
+}
+
+// Whether count elements of elementSize starting at offset lie inside a
+// mapping of size bytes, without the sum overflowing on crafted headers.
+bool fitsIn(std::size_t size, std::uint64_t offset, std::uint64_t count, std::size_t elementSize) {
+    return offset <= size && count <= (size - offset) / elementSize;
+}
+
+} // namespace
+
+void ScheduleView::copyTo(Schedule &schedule) const {
+    schedule.resize(periods);
+    std::copy(payment, payment + periods, schedule.payment.begin());
+    std::copy(principal, principal + periods, schedule.principal.begin());
+    std::copy(interest, interest + periods, schedule.interest.begin());
+    std::copy(balance, balance + periods, schedule.balance.begin());
+    std::copy(prepayment, prepayment + periods, schedule.prepayment.begin());
+
+    double cumPrincipal = 0.0;
+    double cumInterest = 0.0;
+    for (int i = 0; i < periods; ++i) {
+        cumPrincipal += principal[i];
+        cumInterest += interest[i];
+        schedule.cumulativePrincipal[i] = cumPrincipal;
+        schedule.cumulativeInterest[i] = cumInterest;
+    }
+    schedule.paidOffPeriod = paidOffPeriod;
+    schedule.monthlyPayment = monthlyPayment;
+    schedule.totalInterest = totalInterest;
+}
+
+ScheduleFileWriter::~ScheduleFileWriter() {
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool ScheduleFileWriter::open(const std::string &path, std::uint64_t loanCount, std::uint64_t rowCount) {
+    if (fd >= 0)
+        ::close(fd);
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    std::uint64_t offset = 0;
+    header = makeHeader(loanCount, rowCount, offset);
+
+    loansWritten = rowsWritten = loansFlushed = rowsFlushed = 0;
+    stagedEntries.clear();
+    for (std::vector<double> &column : stagedColumns)
+        column.clear();
+    failed = ::ftruncate(fd, static_cast<off_t>(offset)) != 0;
+    return !failed;
+}
+
+bool ScheduleFileWriter::append(const LoanTerms &terms, const Schedule &schedule) {
+    if (fd < 0 || failed)
+        return false;
+    if (loansWritten >= header.loanCount || rowsWritten + schedule.periods > header.rowCount)
+        return false;
+
+    stagedEntries.push_back(makeEntry(terms, schedule, rowsWritten));
+
+    const std::vector<double> *columns[columnCount] = {
+        &schedule.payment, &schedule.principal, &schedule.interest, &schedule.balance, &schedule.prepayment
+    };
+    for (int c = 0; c < columnCount; ++c)
+        stagedColumns[c].insert(stagedColumns[c].end(), columns[c]->begin(), columns[c]->begin() + schedule.periods);
+
+    ++loansWritten;
+    rowsWritten += schedule.periods;
+    if (stagedColumns[0].size() >= stagingRows)
+        return flushStaging();
+    return true;
+}
+
+bool ScheduleFileWriter::flushStaging() {
+    if (!stagedEntries.empty()) {
+        std::uint64_t offset = header.indexOffset + loansFlushed * sizeof(ScheduleFileEntry);
+        if (!writeAt(fd, stagedEntries.data(), stagedEntries.size() * sizeof(ScheduleFileEntry), offset))
+            failed = true;
+        loansFlushed += stagedEntries.size();
+        stagedEntries.clear();
+    }
+    const std::size_t rows = stagedColumns[0].size();
+    if (rows > 0) {
+        for (int c = 0; c < columnCount; ++c) {
+            std::uint64_t offset = header.columnOffset[c] + rowsFlushed * sizeof(double);
+            if (!writeAt(fd, stagedColumns[c].data(), rows * sizeof(double), offset))
+                failed = true;
+            stagedColumns[c].clear();
+        }
+        rowsFlushed += rows;
+    }
+    return !failed;
+}
+
+bool ScheduleFileWriter::close() {
+    if (fd < 0)
+        return false;
+    flushStaging();
+    if (loansWritten != header.loanCount || rowsWritten != header.rowCount)
+        failed = true;
+    // The header goes last so a truncated file never looks complete
+    if (!failed && !writeAt(fd, &header, sizeof(header), 0))
+        failed = true;
+    if (::close(fd) != 0)
+        failed = true;
+    fd = -1;
+    return !failed;
+}
+
+void encodeSchedule(const LoanTerms &terms, const Schedule &schedule, std::string &out) {
+    std::uint64_t size = 0;
+    const std::uint64_t rows = static_cast<std::uint64_t>(schedule.periods);
+    ScheduleFileHeader header = makeHeader(1, rows, size);
+    ScheduleFileEntry entry = makeEntry(terms, schedule, 0);
+
+    const std::size_t start = out.size();
+    out.resize(start + size, '\0');
+    char *file = &out[start];
+    std::memcpy(file, &header, sizeof(header));
+    std::memcpy(file + header.indexOffset, &entry, sizeof(entry));
+    const std::vector<double> *columns[columnCount] = {
+        &schedule.payment, &schedule.principal, &schedule.interest, &schedule.balance, &schedule.prepayment
+    };
+    for (int c = 0; c < columnCount; ++c)
+        std::memcpy(file + header.columnOffset[c], columns[c]->data(), rows * sizeof(double));
+}
+
+ScheduleFileReader::~ScheduleFileReader() {
+    close();
+}
+
+bool ScheduleFileReader::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ScheduleFileHeader))) {
+        ::close(fd);
+        return false;
+    }
+    mappedSize = static_cast<std::size_t>(info.st_size);
+    void *p = ::mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (p == MAP_FAILED) {
+        mappedSize = 0;
+        return false;
+    }
+    mapping = p;
+
+    const auto *h = static_cast<const ScheduleFileHeader *>(mapping);
+    bool ok = std::memcmp(h->magic, fileMagic, sizeof(fileMagic)) == 0
+        && h->version == fileVersion
+        && (h->byteOrder == byteOrderMark || h->byteOrder == 0) // a swapped file fails this or the version
+        && h->columnCount == static_cast<std::uint32_t>(columnCount)
+        && h->indexOffset % alignof(ScheduleFileEntry) == 0
+        && fitsIn(mappedSize, h->indexOffset, h->loanCount, sizeof(ScheduleFileEntry));
+    for (int c = 0; ok && c < columnCount; ++c)
+        ok = h->columnOffset[c] % alignof(double) == 0
+            && fitsIn(mappedSize, h->columnOffset[c], h->rowCount, sizeof(double));
+    if (!ok) {
+        close();
+        return false;
+    }
+    header = h;
+    entries = reinterpret_cast<const ScheduleFileEntry *>(static_cast<const char *>(mapping) + h->indexOffset);
+    return true;
+}
+
+void ScheduleFileReader::close() {
+    if (mapping)
+        ::munmap(mapping, mappedSize);
+    mapping = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+    entries = nullptr;
+}
+
+const double *ScheduleFileReader::column(ScheduleColumn column) const {
+    if (!header || column == ScheduleColumn::Count)
+        return nullptr;
+    return reinterpret_cast<const double *>(static_cast<const char *>(mapping)
+                                            + header->columnOffset[static_cast<int>(column)]);
+}
+
+ScheduleView ScheduleFileReader::loan(std::uint64_t index) const {
+    ScheduleView view;
+    if (!header || index >= header->loanCount)
+        return view;
+    const ScheduleFileEntry &entry = entries[index];
+    if (entry.periods < 0 || entry.firstRow > header->rowCount
+        || static_cast<std::uint64_t>(entry.periods) > header->rowCount - entry.firstRow)
+        return view;
+
+    view.terms.principal = entry.principal;
+    view.terms.annualRate = entry.annualRate;
+    view.terms.months = entry.months;
+    view.periods = entry.periods;
+    view.paidOffPeriod = entry.paidOffPeriod;
+    view.monthlyPayment = entry.monthlyPayment;
+    view.totalInterest = entry.totalInterest;
+    view.payment = column(ScheduleColumn::Payment) + entry.firstRow;
+    view.principal = column(ScheduleColumn::Principal) + entry.firstRow;
+    view.interest = column(ScheduleColumn::Interest) + entry.firstRow;
+    view.balance = column(ScheduleColumn::Balance) + entry.firstRow;
+    view.prepayment = column(ScheduleColumn::Prepayment) + entry.firstRow;
+    return view;
+}
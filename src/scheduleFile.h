@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "amortizationEngine.h"
+
+// Binary columnar schedule files.
+//
+// Layout (little-endian, every section 64-byte aligned):
+//   ScheduleFileHeader
+//   ScheduleFileEntry[loanCount]        per-loan terms, summary and first row
+//   double payment[rowCount]            one contiguous column per field,
+//   double principal[rowCount]          each holding every loan's rows
+//   double interest[rowCount]           back to back
+//   double balance[rowCount]
+//   double prepayment[rowCount]
+//
+// Readers map the file and hand out pointers into it, so serving a loan's
+// schedule or a whole column copies nothing. That only works on
+// little-endian hosts, so the header carries a byte-order marker readers
+// check and other hosts refuse to build.
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "schedule files are read in place and need a little-endian host"
+#endif
+
+enum class ScheduleColumn { Payment, Principal, Interest, Balance, Prepayment, Count };
+
+struct ScheduleFileHeader {
+    char magic[8];            // "AMSCHED1"
+    std::uint32_t version;
+    std::uint32_t columnCount;
+    std::uint64_t loanCount;
+    std::uint64_t rowCount;
+    std::uint64_t indexOffset;
+    std::uint64_t columnOffset[static_cast<int>(ScheduleColumn::Count)];
+    std::uint32_t byteOrder;  // 0x01020304 as written; 0 in files that predate it
+    std::uint8_t reserved[44];
+};
+static_assert(sizeof(ScheduleFileHeader) == 128, "schedule file header layout");
+
+struct ScheduleFileEntry {
+    std::uint64_t firstRow;
+    std::int32_t periods;
+    std::int32_t paidOffPeriod;
+    double principal;
+    double annualRate;
+    std::int32_t months;
+    std::int32_t reserved0;
+    double monthlyPayment;
+    double totalInterest;
+    std::uint64_t reserved1;
+};
+static_assert(sizeof(ScheduleFileEntry) == 64, "schedule file entry layout");
+
+// Read-only view of one loan inside a mapped file.
+struct ScheduleView {
+    LoanTerms terms;
+    int periods = 0;
+    int paidOffPeriod = 0;
+    double monthlyPayment = 0.0;
+    double totalInterest = 0.0;
+    const double *payment = nullptr;
+    const double *principal = nullptr;
+    const double *interest = nullptr;
+    const double *balance = nullptr;
+    const double *prepayment = nullptr;
+
+    // Copies the view into a Schedule, rebuilding the running totals.
+    void copyTo(Schedule &schedule) const;
+};
+
+// Writes a schedule file whose loan and row counts are known up front.
+// Loans are appended in order; each column is staged and written
+// sequentially into its own region of the file.
+class ScheduleFileWriter {
+public:
+    ScheduleFileWriter() = default;
+    ~ScheduleFileWriter();
+
+    ScheduleFileWriter(const ScheduleFileWriter &) = delete;
+    ScheduleFileWriter &operator=(const ScheduleFileWriter &) = delete;
+
+    bool open(const std::string &path, std::uint64_t loanCount, std::uint64_t rowCount);
+    bool append(const LoanTerms &terms, const Schedule &schedule);
+    // Writes the header; fails if fewer loans or rows were appended than declared.
+    bool close();
+
+private:
+    bool flushStaging();
+
+    int fd = -1;
+    ScheduleFileHeader header{};
+    std::uint64_t loansWritten = 0;
+    std::uint64_t rowsWritten = 0;
+    std::uint64_t loansFlushed = 0;
+    std::uint64_t rowsFlushed = 0;
+    std::vector<ScheduleFileEntry> stagedEntries;
+    std::vector<double> stagedColumns[static_cast<int>(ScheduleColumn::Count)];
+    bool failed = false;
+};
+
+// Appends a complete one-loan schedule file to out, for sending the format
+// over a pipe or socket instead of writing it to disk.
+void encodeSchedule(const LoanTerms &terms, const Schedule &schedule, std::string &out);
+
+// Memory-maps a schedule file for zero-copy access.
+class ScheduleFileReader {
+public:
+    ScheduleFileReader() = default;
+    ~ScheduleFileReader();
+
+    ScheduleFileReader(const ScheduleFileReader &) = delete;
+    ScheduleFileReader &operator=(const ScheduleFileReader &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    std::uint64_t loanCount() const { return header ? header->loanCount : 0; }
+    std::uint64_t rowCount() const { return header ? header->rowCount : 0; }
+
+    ScheduleView loan(std::uint64_t index) const;
+    // Every loan's values for one field, rowCount() long.
+    const double *column(ScheduleColumn column) const;
+
+private:
+    void *mapping = nullptr;
+    std::size_t mappedSize = 0;
+    const ScheduleFileHeader *header = nullptr;
+    const ScheduleFileEntry *entries = nullptr;
+};
@@ -0,0 +1,106 @@
+#include "scheduleModel.h"
+#include <algorithm>
+#include <cmath>
+
+ScheduleModel::ScheduleModel(Schedule *schedule, QObject *parent)
+    : QAbstractTableModel(parent), schedule(schedule) {}
+
+int ScheduleModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : rows;
+}
+
+int ScheduleModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ScheduleModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= rows || index.row() >= schedule->periods)
+        return QVariant();
+    if (role != Qt::DisplayRole && role != Qt::EditRole)
+        return QVariant();
+
+    const int row = index.row();
+    switch (index.column()) {
+    case PaymentNumber:
+        return QString::number(row + 1);
+    case Payment:
+        return QString::number(schedule->payment[row], 'f', 2);
+    case Principal:
+        return QString::number(schedule->principal[row], 'f', 2);
+    case Interest:
+        return QString::number(schedule->interest[row], 'f', 2);
+    case Balance:
+        return QString::number(schedule->balance[row], 'f', 2);
+    case OneTimePayment:
+        // Leave the cell blank unless a payment was entered
+        if (schedule->prepayment[row] == 0.0)
+            return QString();
+        return QString::number(schedule->prepayment[row], 'f', 2);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ScheduleModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    // Left-justify all header titles
+    if (role == Qt::TextAlignmentRole)
+        return int(Qt::AlignLeft | Qt::AlignVCenter);
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    static const char *const headers[ColumnCount] = {
+        "Payment #", "Payment", "Principal", "Interest", "Balance", "One-Time Payment"
+    };
+    if (section < 0 || section >= ColumnCount)
+        return QVariant();
+    return QString(headers[section]);
+}
+
+Qt::ItemFlags ScheduleModel::flags(const QModelIndex &index) const {
+    Qt::ItemFlags f = QAbstractTableModel::flags(index);
+    if (index.isValid() && index.column() == OneTimePayment && prepaymentsEditable)
+        f |= Qt::ItemIsEditable;
+    return f;
+}
+
+bool ScheduleModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    if (!index.isValid() || role != Qt::EditRole || index.column() != OneTimePayment)
+        return false;
+    if (index.row() >= rows || index.row() >= schedule->periods)
+        return false;
+
+    // Accept commas in dollar amounts; a blank cell clears the payment
+    QString text = value.toString().remove(',').trimmed();
+    double amount = 0.0;
+    if (!text.isEmpty()) {
+        bool ok = false;
+        amount = text.toDouble(&ok);
+        if (!ok || amount < 0 || !std::isfinite(amount))
+            return false;
+    }
+
+    emit prepaymentEdited(index.row(), amount);
+    return true;
+}
+
+void ScheduleModel::reload() {
+    // Same length: repaint in place so the view keeps its scroll position
+    if (schedule->periods == rows) {
+        if (rows > 0)
+            emit dataChanged(index(0, 0), index(rows - 1, ColumnCount - 1));
+        return;
+    }
+    beginResetModel();
+    rows = schedule->periods;
+    endResetModel();
+}
+
+void ScheduleModel::rowsChanged(int first, int last) {
+    if (first > last || first >= rows)
+        return;
+    last = std::min(last, rows - 1);
+    emit dataChanged(index(first, 0), index(last, ColumnCount - 1), {Qt::DisplayRole, Qt::EditRole});
+}
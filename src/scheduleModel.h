@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include "amortizationEngine.h"
+
+// Table model over a Schedule. Cells are formatted on demand in data(), so
+// only the rows a view actually paints cost anything.
+class ScheduleModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Column { PaymentNumber, Payment, Principal, Interest, Balance, OneTimePayment, ColumnCount };
+
+    explicit ScheduleModel(Schedule *schedule, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+    // Call after the schedule buffer has been recomputed.
+    void reload();
+    // Call after rows first..last were recomputed in place.
+    void rowsChanged(int first, int last);
+    // Off for schedules that are not a single loan's, such as an aggregate.
+    void setPrepaymentsEditable(bool editable) { prepaymentsEditable = editable; }
+
+signals:
+    // A one-time payment cell was edited to amount, the month's new total.
+    // The cell keeps its value until the owner recomputes the schedule.
+    void prepaymentEdited(int row, double amount);
+
+private:
+    Schedule *schedule;
+    int rows = 0; // row count last published to views
+    bool prepaymentsEditable = true;
+};
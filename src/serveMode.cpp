@@ -0,0 +1,973 @@
+#include "serveMode.h"
+#include "amortizationEngine.h"
+#include "batchKernel.h"
+#include "loanFile.h"
+#include "loanQuery.h"
+#include "quantileSketch.h"
+#include "scheduleExport.h"
+#include "scheduleFile.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ServeOptions {
+    std::string socketPath;
+    int port = 0;
+    int threads = 0;
+    int maxBatch = 4096;
+};
+
+const std::size_t maxLineBytes = 1 << 20;
+const std::size_t maxOutputBytes = 16 << 20;  // stop reading a client that is not reading its answers
+const std::uint64_t maxOutstanding = 1 << 16; // requests read but not yet answered, per client
+const std::size_t summaryChunk = 1024;        // summaries per task; the batch kernel wants many loans
+const std::size_t scheduleChunk = 32;         // full schedules per task
+const double maxMonths = maxTermMonths;       // keeps one request from asking for gigabytes
+const int maxNesting = 64;                    // arrays and objects inside skipped values
+
+enum class Op { Summary, Schedule, Query, Stats, Count };
+const char *const opNames[] = {"summary", "schedule", "query", "stats"};
+
+struct Request {
+    std::string id = "null"; // raw JSON value, echoed back as written
+    Op op = Op::Summary;
+    LoanRecord loan;
+    int month = 0;
+    bool binary = false;
+};
+
+// A request handed to the pool, tagged with where its answer goes.
+struct Job {
+    std::uint64_t connection = 0;
+    std::uint64_t sequence = 0;
+    Clock::time_point arrived;
+    Request request;
+};
+
+struct Answer {
+    std::uint64_t connection = 0;
+    std::uint64_t sequence = 0;
+    Clock::time_point arrived;
+    Op op = Op::Summary;
+    std::string text;
+};
+
+volatile std::sig_atomic_t stopRequested = 0;
+int signalWakeFd = -1;
+
+void handleStopSignal(int) {
+    stopRequested = 1;
+    if (signalWakeFd >= 0) {
+        char byte = 0;
+        ssize_t ignored = write(signalWakeFd, &byte, 1);
+        (void)ignored;
+    }
+}
+
+void printUsage() {
+    std::fprintf(stderr,
+        "Usage: amortizationCalcQt --serve [--socket <path> | --port N]\n"
+        "                          [--threads N] [--max-batch N]\n"
+        "\n"
+        "Answers newline-delimited JSON requests on a Unix domain socket or on\n"
+        "127.0.0.1:N. Requests arriving together are computed in batches of up to\n"
+        "--max-batch (default 4096). See serveMode.h for the protocol.\n");
+}
+
+bool parseOptions(int argc, char *argv[], ServeOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--serve") == 0) {
+            continue;
+        } else if (std::strcmp(arg, "--socket") == 0 && hasValue) {
+            options.socketPath = argv[++i];
+        } else if (std::strcmp(arg, "--port") == 0 && hasValue) {
+            options.port = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--max-batch") == 0 && hasValue) {
+            options.maxBatch = std::atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    if (options.socketPath.empty() == (options.port == 0))
+        return false;
+    return options.port >= 0 && options.port <= 65535 && options.maxBatch >= 1;
+}
+
+// Just enough JSON for flat request objects. Escapes inside strings are
+// skipped over but not decoded; no field the server reads needs them.
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view text) : s(text) {}
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos < s.size() && s[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return pos >= s.size();
+    }
+
+    bool string(std::string_view &out) {
+        if (!consume('"'))
+            return false;
+        std::size_t start = pos;
+        while (pos < s.size() && s[pos] != '"')
+            pos += s[pos] == '\\' ? 2 : 1;
+        if (pos >= s.size())
+            return false;
+        out = s.substr(start, pos - start);
+        ++pos;
+        return true;
+    }
+
+    bool number(double &out) {
+        skipSpace();
+        const char *first = s.data() + pos;
+        auto result = std::from_chars(first, s.data() + s.size(), out);
+        if (result.ec != std::errc() || !std::isfinite(out))
+            return false;
+        pos += result.ptr - first;
+        return true;
+    }
+
+    // Skips over one value of any type and returns its text. Values nested
+    // deeper than maxNesting are refused so a hostile line cannot exhaust
+    // the stack.
+    bool value(std::string_view &out, int depth = 0) {
+        skipSpace();
+        std::size_t start = pos;
+        if (pos >= s.size())
+            return false;
+        char c = s[pos];
+        if (c == '"') {
+            std::string_view ignored;
+            if (!string(ignored))
+                return false;
+        } else if (c == '{' || c == '[') {
+            if (depth >= maxNesting)
+                return false;
+            char close = c == '{' ? '}' : ']';
+            ++pos;
+            if (!consume(close)) {
+                do {
+                    std::string_view ignored;
+                    if (c == '{' && (!string(ignored) || !consume(':')))
+                        return false;
+                    if (!value(ignored, depth + 1))
+                        return false;
+                } while (consume(','));
+                if (!consume(close))
+                    return false;
+            }
+        } else {
+            // number, true, false or null
+            while (pos < s.size() && std::strchr(",:{}[]\" \t\r\n", s[pos]) == nullptr)
+                ++pos;
+            if (pos == start)
+                return false;
+        }
+        out = s.substr(start, pos - start);
+        return true;
+    }
+
+private:
+    void skipSpace() {
+        while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\r' || s[pos] == '\n'))
+            ++pos;
+    }
+
+    std::string_view s;
+    std::size_t pos = 0;
+};
+
+void appendJsonString(std::string &out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Whether text, one scalar value as JsonReader::value() returns it, is
+// valid JSON and so safe to echo: a string without raw control characters or
+// unknown escapes, a number in JSON's grammar, true, false or null.
+bool isJsonScalar(std::string_view text) {
+    if (text == "true" || text == "false" || text == "null")
+        return true;
+    auto digits = [&text](std::size_t &i) {
+        std::size_t start = i;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9')
+            ++i;
+        return i > start;
+    };
+    if (text.front() == '"') {
+        for (std::size_t i = 1; i + 1 < text.size(); ++i) {
+            if (static_cast<unsigned char>(text[i]) < 0x20)
+                return false;
+            if (text[i] != '\\')
+                continue;
+            char escape = text[++i];
+            if (escape == 'u') {
+                if (i + 5 >= text.size())
+                    return false;
+                for (int k = 0; k < 4; ++k) {
+                    if (!std::isxdigit(static_cast<unsigned char>(text[++i])))
+                        return false;
+                }
+            } else if (escape == '\0' || std::strchr("\"\\/bfnrt", escape) == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    std::size_t i = 0;
+    if (text[i] == '-')
+        ++i;
+    if (i < text.size() && text[i] == '0')
+        ++i;
+    else if (!digits(i))
+        return false;
+    if (i < text.size() && text[i] == '.' && !digits(++i))
+        return false;
+    if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+        ++i;
+        if (i < text.size() && (text[i] == '+' || text[i] == '-'))
+            ++i;
+        if (!digits(i))
+            return false;
+    }
+    return i == text.size();
+}
+
+// [[month, amount], ...]; every month must be in the term's range and every
+// amount positive, so a bad entry is reported rather than dropped.
+bool parsePrepayments(JsonReader &json, std::vector<Prepayment> &out) {
+    if (!json.consume('['))
+        return false;
+    if (json.consume(']'))
+        return true;
+    do {
+        double month = 0.0;
+        Prepayment payment;
+        if (!json.consume('[') || !json.number(month) || !json.consume(',') || !json.number(payment.amount)
+            || !json.consume(']'))
+            return false;
+        if (!(month >= 1 && month <= maxMonths && payment.amount > 0))
+            return false;
+        payment.month = static_cast<int>(month);
+        out.push_back(payment);
+    } while (json.consume(','));
+    return json.consume(']');
+}
+
+bool parseRequest(std::string_view line, Request &request, std::string &error) {
+    JsonReader json(line);
+    double term = 0.0;
+    bool years = false;
+    if (!json.consume('{')) {
+        error = "expected a JSON object";
+        return false;
+    }
+    if (!json.consume('}')) {
+        do {
+            std::string_view key;
+            if (!json.string(key) || !json.consume(':')) {
+                error = "malformed JSON object";
+                return false;
+            }
+            bool ok = true;
+            std::string_view text;
+            if (key == "id") {
+                ok = json.value(text) && text.front() != '{' && text.front() != '[' && isJsonScalar(text);
+                if (ok)
+                    request.id.assign(text);
+            } else if (key == "op") {
+                ok = json.string(text);
+                auto name = std::find(std::begin(opNames), std::end(opNames), text);
+                ok = ok && name != std::end(opNames);
+                if (ok)
+                    request.op = static_cast<Op>(name - std::begin(opNames));
+            } else if (key == "principal") {
+                ok = json.number(request.loan.terms.principal);
+            } else if (key == "rate") {
+                ok = json.number(request.loan.terms.annualRate);
+            } else if (key == "term") {
+                ok = json.number(term);
+            } else if (key == "units") {
+                ok = json.string(text);
+                years = !text.empty() && (text.front() == 'y' || text.front() == 'Y');
+            } else if (key == "month") {
+                double month = 0.0;
+                ok = json.number(month);
+                request.month = static_cast<int>(std::clamp(month, 0.0, maxMonths));
+            } else if (key == "format") {
+                ok = json.string(text);
+                request.binary = text == "binary";
+            } else if (key == "prepayments") {
+                ok = parsePrepayments(json, request.loan.prepayments);
+            } else {
+                ok = json.value(text);
+            }
+            if (!ok) {
+                error = "bad value for " + std::string(key);
+                return false;
+            }
+        } while (json.consume(','));
+        if (!json.consume('}')) {
+            error = "malformed JSON object";
+            return false;
+        }
+    }
+    if (!json.atEnd()) {
+        error = "one JSON object per line";
+        return false;
+    }
+    if (!(term >= 0 && (years ? term * 12 : term) <= maxMonths)) {
+        error = "term out of range";
+        return false;
+    }
+    request.loan.terms.months = termToMonths(term, years ? TermUnit::Years : TermUnit::Months);
+    return true;
+}
+
+void beginAnswer(std::string &out, const std::string &id) {
+    out += "{\"id\":";
+    out += id;
+}
+
+void appendError(std::string &out, const std::string &id, std::string_view message) {
+    beginAnswer(out, id);
+    out += ",\"error\":";
+    appendJsonString(out, message);
+    out += "}\n";
+}
+
+void appendColumn(std::string &out, const char *name, const std::vector<double> &column, int rows) {
+    out += ",\"";
+    out += name;
+    out += "\":[";
+    for (int i = 0; i < rows; ++i) {
+        if (i > 0)
+            out += ',';
+        appendMoney(out, column[i]);
+    }
+    out += ']';
+}
+
+Answer answerFor(const Job &job) {
+    Answer answer;
+    answer.connection = job.connection;
+    answer.sequence = job.sequence;
+    answer.arrived = job.arrived;
+    answer.op = job.request.op;
+    return answer;
+}
+
+// Every summary in jobs goes through the batch kernel in one call.
+void answerSummaries(std::vector<Job> &jobs, std::vector<Answer> &answers) {
+    thread_local std::vector<LoanRecord> records;
+    thread_local std::vector<LoanSummary> summaries;
+
+    records.resize(jobs.size());
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+        records[i] = std::move(jobs[i].request.loan);
+    summarizeLoans(records.data(), static_cast<int>(jobs.size()), summaries);
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        Answer answer = answerFor(jobs[i]);
+        const std::string &id = jobs[i].request.id;
+        const LoanSummary &summary = summaries[i];
+        if (!isValid(records[i].terms)) {
+            appendError(answer.text, id, "invalid loan terms");
+        } else {
+            std::string &out = answer.text;
+            beginAnswer(out, id);
+            out += ",\"payment\":";
+            appendMoney(out, summary.monthlyPayment);
+            out += ",\"totalInterest\":";
+            appendMoney(out, summary.totalInterest);
+            out += ",\"totalPaid\":";
+            appendMoney(out, records[i].terms.principal + summary.totalInterest);
+            out += ",\"payoffMonth\":";
+            appendInt(out, summary.paidOffPeriod);
+            out += "}\n";
+        }
+        answers.push_back(std::move(answer));
+    }
+}
+
+void answerSchedule(const Job &job, Answer &answer) {
+    thread_local Schedule schedule;
+    const Request &request = job.request;
+    std::string &out = answer.text;
+    if (!amortize(request.loan, schedule)) {
+        appendError(out, request.id, "invalid loan terms");
+        return;
+    }
+    if (request.binary) {
+        thread_local std::string payload;
+        payload.clear();
+        encodeSchedule(request.loan.terms, schedule, payload);
+        beginAnswer(out, request.id);
+        out += ",\"bytes\":";
+        appendInt(out, static_cast<long long>(payload.size()));
+        out += "}\n";
+        out += payload;
+        return;
+    }
+    beginAnswer(out, request.id);
+    out += ",\"payoffMonth\":";
+    appendInt(out, schedule.paidOffPeriod);
+    appendColumn(out, "payment", schedule.payment, schedule.periods);
+    appendColumn(out, "principal", schedule.principal, schedule.periods);
+    appendColumn(out, "interest", schedule.interest, schedule.periods);
+    appendColumn(out, "balance", schedule.balance, schedule.periods);
+    appendColumn(out, "prepayment", schedule.prepayment, schedule.periods);
+    out += "}\n";
+}
+
+// Closed form, so a query never builds the schedule.
+void answerQuery(const Job &job, Answer &answer) {
+    const Request &request = job.request;
+    LoanQuery query(request.loan.terms, request.loan.prepayments);
+    if (!query.isValid()) {
+        appendError(answer.text, request.id, "invalid loan terms");
+        return;
+    }
+    if (request.month < 1 || request.month > request.loan.terms.months) {
+        appendError(answer.text, request.id, "month out of range");
+        return;
+    }
+    std::string &out = answer.text;
+    beginAnswer(out, request.id);
+    out += ",\"month\":";
+    appendInt(out, request.month);
+    out += ",\"balance\":";
+    appendMoney(out, query.balanceAfter(request.month));
+    out += ",\"interestPaid\":";
+    appendMoney(out, query.interestThrough(request.month));
+    out += ",\"principalPaid\":";
+    appendMoney(out, query.principalThrough(request.month));
+    out += "}\n";
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+int listenUnix(const std::string &path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::fprintf(stderr, "Socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+    // Replace a socket left behind by an earlier run, but never a regular file
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || listen(fd, SOMAXCONN) != 0) {
+        std::fprintf(stderr, "Failed to listen on %s: %s\n", path.c_str(), std::strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Binds 127.0.0.1 only; the service is for processes on the same machine.
+int listenLocalhost(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+        || bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || listen(fd, SOMAXCONN) != 0) {
+        std::fprintf(stderr, "Failed to listen on 127.0.0.1:%d: %s\n", port, std::strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+class Server {
+public:
+    Server(const ServeOptions &options, int listenFd, int wakeFd)
+        : options(options), listenFd(listenFd), wakeFd(wakeFd), started(Clock::now()),
+          pool(options.threads) {
+        for (QuantileSketch &sketch : latency)
+            sketch = QuantileSketch(0.1);
+    }
+
+    // Runs until SIGINT or SIGTERM, then lets the work in flight finish.
+    void run(int wakeReadFd);
+    void printStats() const;
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string in;
+        std::string out;
+        std::size_t sent = 0;
+        std::uint64_t nextSequence = 0; // given to the next request read
+        std::uint64_t nextToSend = 0;
+        std::map<std::uint64_t, std::string> ready; // answers waiting on earlier ones
+        bool readClosed = false;
+        bool failed = false;
+
+        bool wantsInput() const {
+            return !readClosed && out.size() - sent < maxOutputBytes && nextSequence - nextToSend < maxOutstanding;
+        }
+        bool finished() const { return failed || (readClosed && nextToSend == nextSequence && sent == out.size()); }
+    };
+
+    void acceptClients();
+    void readFrom(std::uint64_t id, Connection &connection);
+    void handleLine(std::uint64_t id, Connection &connection, std::string_view line);
+    void flush(Connection &connection);
+    void deliver(Answer &answer);
+    void collectAnswers();
+    void dispatch();
+    void submit(std::vector<Job> jobs);
+    std::string statsAnswer(const std::string &id) const;
+
+    const ServeOptions &options;
+    int listenFd;
+    int wakeFd;
+    Clock::time_point started;
+    std::map<std::uint64_t, Connection> connections;
+    std::uint64_t nextConnection = 1;
+    std::deque<Job> pending;
+    int tasksInFlight = 0;
+
+    std::mutex finishedMutex;
+    std::vector<std::vector<Answer>> finishedTasks; // filled by workers
+
+    QuantileSketch latency[static_cast<int>(Op::Count)];
+    long long batches = 0;
+    long long batchedRequests = 0;
+    long long malformed = 0;
+
+    // Last, so the workers are joined before anything they touch goes away
+    ThreadPool pool;
+};
+
+void Server::acceptClients() {
+    for (;;) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+            return; // EAGAIN once the backlog is empty
+        setNonBlocking(fd);
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // fails harmlessly on Unix sockets
+        connections[nextConnection++].fd = fd;
+    }
+}
+
+void Server::readFrom(std::uint64_t id, Connection &connection) {
+    char buffer[64 << 10];
+    // Bounded so one busy client cannot starve the others
+    for (int reads = 0; reads < 16 && connection.wantsInput(); ++reads) {
+        ssize_t n = read(connection.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            connection.in.append(buffer, static_cast<std::size_t>(n));
+        } else if (n == 0) {
+            connection.readClosed = true;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                connection.failed = true;
+            break;
+        }
+        if (n < static_cast<ssize_t>(sizeof(buffer)))
+            break;
+    }
+
+    std::size_t start = 0;
+    for (;;) {
+        std::size_t end = connection.in.find('\n', start);
+        if (end == std::string::npos)
+            break;
+        handleLine(id, connection, std::string_view(connection.in).substr(start, end - start));
+        start = end + 1;
+    }
+    connection.in.erase(0, start);
+    if (connection.in.size() > maxLineBytes) {
+        ++malformed;
+        Answer answer;
+        answer.connection = id;
+        answer.sequence = connection.nextSequence++;
+        answer.arrived = Clock::now();
+        answer.op = Op::Count;
+        appendError(answer.text, "null", "request line too long");
+        deliver(answer);
+        connection.in.clear();
+        connection.readClosed = true;
+    }
+    if (connection.readClosed && !connection.in.empty()) {
+        handleLine(id, connection, connection.in); // last line without a newline
+        connection.in.clear();
+    }
+}
+
+void Server::handleLine(std::uint64_t id, Connection &connection, std::string_view line) {
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+        line.remove_suffix(1);
+    if (line.empty())
+        return;
+
+    Job job;
+    job.connection = id;
+    job.sequence = connection.nextSequence++;
+    job.arrived = Clock::now();
+    std::string error;
+    if (!parseRequest(line, job.request, error)) {
+        ++malformed;
+        Answer answer = answerFor(job);
+        answer.op = Op::Count; // not timed
+        appendError(answer.text, job.request.id, error);
+        deliver(answer);
+    } else if (job.request.op == Op::Stats) {
+        Answer answer = answerFor(job);
+        answer.text = statsAnswer(job.request.id);
+        deliver(answer);
+    } else {
+        pending.push_back(std::move(job));
+    }
+}
+
+// Queues answer behind any earlier answers on its connection still being
+// computed; records its latency from when the request was read.
+void Server::deliver(Answer &answer) {
+    if (answer.op != Op::Count) {
+        double micros = std::chrono::duration<double, std::micro>(Clock::now() - answer.arrived).count();
+        latency[static_cast<int>(answer.op)].add(micros);
+    }
+    auto found = connections.find(answer.connection);
+    if (found == connections.end())
+        return; // client went away
+    Connection &connection = found->second;
+    if (answer.sequence != connection.nextToSend) {
+        connection.ready.emplace(answer.sequence, std::move(answer.text));
+        return;
+    }
+    connection.out += answer.text;
+    ++connection.nextToSend;
+    for (auto next = connection.ready.begin();
+         next != connection.ready.end() && next->first == connection.nextToSend;
+         next = connection.ready.erase(next)) {
+        connection.out += next->second;
+        ++connection.nextToSend;
+    }
+}
+
+void Server::flush(Connection &connection) {
+    while (connection.sent < connection.out.size()) {
+        ssize_t n = send(connection.fd, connection.out.data() + connection.sent,
+                         connection.out.size() - connection.sent, 0);
+        if (n > 0) {
+            connection.sent += static_cast<std::size_t>(n);
+        } else {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                connection.failed = true;
+            break;
+        }
+    }
+    if (connection.sent == connection.out.size()) {
+        connection.out.clear();
+        connection.sent = 0;
+    } else if (connection.sent > (1 << 20)) {
+        connection.out.erase(0, connection.sent);
+        connection.sent = 0;
+    }
+}
+
+void Server::collectAnswers() {
+    std::vector<std::vector<Answer>> done;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        done.swap(finishedTasks);
+    }
+    for (std::vector<Answer> &answers : done) {
+        --tasksInFlight;
+        for (Answer &answer : answers)
+            deliver(answer);
+    }
+}
+
+void Server::submit(std::vector<Job> jobs) {
+    ++tasksInFlight;
+    pool.submit([this, jobs = std::move(jobs)]() mutable {
+        std::vector<Answer> answers;
+        answers.reserve(jobs.size());
+        if (jobs.front().request.op == Op::Summary) {
+            answerSummaries(jobs, answers);
+        } else {
+            for (const Job &job : jobs) {
+                answers.push_back(answerFor(job));
+                if (job.request.op == Op::Schedule)
+                    answerSchedule(job, answers.back());
+                else
+                    answerQuery(job, answers.back());
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(finishedMutex);
+            finishedTasks.push_back(std::move(answers));
+        }
+        char byte = 0;
+        ssize_t ignored = write(wakeFd, &byte, 1); // a full pipe already means "wake up"
+        (void)ignored;
+    });
+}
+
+// Requests are not held back to fill a batch: whatever arrived while the
+// workers were busy goes out together, so batches grow with the load and a
+// lone request is computed straight away.
+void Server::dispatch() {
+    const int maxTasks = pool.size() * 2;
+    while (!pending.empty() && tasksInFlight < maxTasks) {
+        std::size_t count = std::min(pending.size(), static_cast<std::size_t>(options.maxBatch));
+        std::vector<Job> summaries;
+        std::vector<Job> others;
+        for (std::size_t i = 0; i < count; ++i) {
+            Job &job = pending.front();
+            (job.request.op == Op::Summary ? summaries : others).push_back(std::move(job));
+            pending.pop_front();
+        }
+        ++batches;
+        batchedRequests += static_cast<long long>(count);
+
+        auto split = [this](std::vector<Job> &jobs, std::size_t chunk) {
+            // Even chunks across the workers, but no smaller than needed
+            std::size_t tasks = std::max<std::size_t>(1, std::min<std::size_t>(pool.size(), (jobs.size() + chunk - 1) / chunk));
+            std::size_t per = (jobs.size() + tasks - 1) / tasks;
+            for (std::size_t first = 0; first < jobs.size(); first += per) {
+                std::size_t last = std::min(jobs.size(), first + per);
+                submit(std::vector<Job>(std::make_move_iterator(jobs.begin() + first),
+                                        std::make_move_iterator(jobs.begin() + last)));
+            }
+        };
+        split(summaries, summaryChunk);
+        split(others, scheduleChunk);
+    }
+}
+
+std::string Server::statsAnswer(const std::string &id) const {
+    std::string out;
+    beginAnswer(out, id);
+    out += ",\"uptimeSeconds\":";
+    appendInt(out, std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - started).count());
+    out += ",\"threads\":";
+    appendInt(out, pool.size());
+    out += ",\"connections\":";
+    appendInt(out, static_cast<long long>(connections.size()));
+    out += ",\"batches\":";
+    appendInt(out, batches);
+    out += ",\"meanBatch\":";
+    appendMoney(out, batches > 0 ? static_cast<double>(batchedRequests) / batches : 0.0);
+    out += ",\"malformed\":";
+    appendInt(out, malformed);
+    out += ",\"latencyMicros\":{";
+    for (int op = 0; op < static_cast<int>(Op::Stats); ++op) {
+        const QuantileSketch &sketch = latency[op];
+        if (op > 0)
+            out += ',';
+        out += '"';
+        out += opNames[op];
+        out += "\":{\"count\":";
+        appendInt(out, static_cast<long long>(sketch.count()));
+        const std::pair<const char *, double> quantiles[] = {
+            {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}, {"max", 1.0}};
+        for (const auto &[name, q] : quantiles) {
+            out += ",\"";
+            out += name;
+            out += "\":";
+            appendMoney(out, sketch.quantile(q));
+        }
+        out += '}';
+    }
+    out += "}}\n";
+    return out;
+}
+
+void Server::run(int wakeReadFd) {
+    std::vector<pollfd> fds;
+    std::vector<std::uint64_t> ids; // connection id of fds[i + 2]
+    bool stopping = false;
+
+    for (;;) {
+        if (stopRequested && !stopping) {
+            stopping = true;
+            close(listenFd);
+            listenFd = -1;
+            for (auto &entry : connections)
+                entry.second.readClosed = true; // finish what was asked, take nothing new
+        }
+        dispatch();
+        for (auto it = connections.begin(); it != connections.end();) {
+            flush(it->second);
+            if (it->second.finished()) {
+                close(it->second.fd);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (stopping && connections.empty() && tasksInFlight == 0)
+            return;
+
+        fds.clear();
+        ids.clear();
+        fds.push_back({wakeReadFd, POLLIN, 0});
+        fds.push_back({listenFd, static_cast<short>(stopping ? 0 : POLLIN), 0});
+        for (auto &[id, connection] : connections) {
+            short events = 0;
+            if (connection.wantsInput())
+                events |= POLLIN;
+            if (connection.sent < connection.out.size())
+                events |= POLLOUT;
+            fds.push_back({connection.fd, events, 0});
+            ids.push_back(id);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::fprintf(stderr, "poll failed: %s\n", std::strerror(errno));
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char drain[256];
+            while (read(wakeReadFd, drain, sizeof(drain)) > 0) {
+            }
+        }
+        collectAnswers();
+        if (fds[1].revents & POLLIN)
+            acceptClients();
+        for (std::size_t i = 2; i < fds.size(); ++i) {
+            auto found = connections.find(ids[i - 2]);
+            if (found == connections.end())
+                continue;
+            Connection &connection = found->second;
+            if (fds[i].revents & (POLLIN | POLLHUP))
+                readFrom(found->first, connection);
+            if (fds[i].revents & (POLLERR | POLLNVAL))
+                connection.failed = true;
+        }
+    }
+}
+
+void Server::printStats() const {
+    std::fprintf(stderr, "Served %lld requests in %lld batches (mean %.1f per batch, %lld malformed)\n",
+                 batchedRequests, batches, batches > 0 ? static_cast<double>(batchedRequests) / batches : 0.0,
+                 malformed);
+    for (int op = 0; op < static_cast<int>(Op::Stats); ++op) {
+        const QuantileSketch &sketch = latency[op];
+        if (sketch.count() == 0)
+            continue;
+        std::fprintf(stderr, "  %-8s %10llu requests  p50 %.0f us  p99 %.0f us  max %.0f us\n", opNames[op],
+                     static_cast<unsigned long long>(sketch.count()), sketch.quantile(0.5), sketch.quantile(0.99),
+                     sketch.quantile(1.0));
+    }
+}
+
+} // namespace
+
+int runServe(int argc, char *argv[]) {
+    ServeOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    int listenFd = options.socketPath.empty() ? listenLocalhost(options.port) : listenUnix(options.socketPath);
+    if (listenFd < 0)
+        return 1;
+    setNonBlocking(listenFd);
+
+    // Workers and signal handlers wake the poll loop through this pipe
+    int wake[2];
+    if (pipe(wake) != 0) {
+        std::fprintf(stderr, "Failed to create pipe: %s\n", std::strerror(errno));
+        return 1;
+    }
+    setNonBlocking(wake[0]);
+    setNonBlocking(wake[1]);
+    signalWakeFd = wake[1];
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+
+    {
+        Server server(options, listenFd, wake[1]);
+        if (options.socketPath.empty())
+            std::fprintf(stderr, "Serving on 127.0.0.1:%d with %s kernel\n", options.port, loanBatchKernel());
+        else
+            std::fprintf(stderr, "Serving on %s with %s kernel\n", options.socketPath.c_str(), loanBatchKernel());
+        server.run(wake[0]);
+        server.printStats();
+    }
+
+    signalWakeFd = -1;
+    close(wake[0]);
+    close(wake[1]);
+    if (!options.socketPath.empty())
+        unlink(options.socketPath.c_str());
+    return 0;
+}
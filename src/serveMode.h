@@ -0,0 +1,26 @@
+#pragma once
+
+// Headless entry point used by main() when --serve is on the command line.
+// Answers amortization requests from other processes over a Unix domain
+// socket or a localhost TCP port without creating any Qt objects.
+//
+// Requests and responses are single lines of JSON. Requests carry an "op"
+// and an optional "id" that is echoed back; responses on one connection come
+// back in request order.
+//
+//   {"id":1,"op":"summary","principal":300000,"rate":6.5,"term":30,"units":"years",
+//    "prepayments":[[12,5000],[24,5000]]}
+//     -> {"id":1,"payment":1896.20,"totalInterest":...,"totalPaid":...,"payoffMonth":...}
+//   {"id":2,"op":"schedule",...loan fields...}
+//     -> {"id":2,"payoffMonth":...,"payment":[...],"principal":[...],"interest":[...],
+//         "balance":[...],"prepayment":[...]}
+//   {"id":3,"op":"schedule","format":"binary",...}
+//     -> {"id":3,"bytes":N} followed by N bytes of a one-loan schedule file
+//        (see scheduleFile.h)
+//   {"id":4,"op":"query","month":120,...loan fields...}
+//     -> {"id":4,"month":120,"balance":...,"interestPaid":...,"principalPaid":...}
+//   {"id":5,"op":"stats"}
+//     -> request counts and latency percentiles in microseconds per op
+//
+// "units" defaults to months. Failures answer {"id":...,"error":"..."}.
+int runServe(int argc, char *argv[]);
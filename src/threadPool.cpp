@@ -0,0 +1,94 @@
+#include "threadPool.h"
+
+namespace {
+
+// Pool and queue of the worker running on this thread, if any
+thread_local const void *currentPool = nullptr;
+thread_local int currentWorker = -1;
+
+} // namespace
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0)
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads <= 0)
+        threads = 1;
+    queues.reserve(threads);
+    for (int i = 0; i < threads; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    workers.reserve(threads);
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back([this, i]() { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    // Workers keep their own submissions; other threads share one queue
+    Queue &target = currentPool == this ? *queues[currentWorker] : injected;
+    {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        target.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        ++pending;
+    }
+    wake.notify_one();
+}
+
+// Own tasks newest first, then outside submissions oldest first (callers
+// such as batch mode collect results in submission order), then steal the
+// oldest task of another worker.
+bool ThreadPool::takeTask(int worker, std::function<void()> &task) {
+    auto take = [&task](Queue &queue, bool newest) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        if (newest) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    };
+
+    const int count = static_cast<int>(queues.size());
+    if (take(*queues[worker], true) || take(injected, false))
+        return true;
+    for (int i = 1; i < count; ++i) {
+        if (take(*queues[(worker + i) % count], false))
+            return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int worker) {
+    currentPool = this;
+    currentWorker = worker;
+    for (;;) {
+        std::function<void()> task;
+        if (takeTask(worker, task)) {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                --pending;
+            }
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return stopping || pending > 0; });
+        if (stopping && pending == 0)
+            return; // stopping and drained
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size pool of worker threads, each with its own task deque. Tasks
+// submitted from inside a task stay on that worker's deque and run newest
+// first; tasks from other threads go to one shared queue and start in
+// submission order. Workers that run dry steal the oldest from the others.
+class ThreadPool {
+public:
+    // threads <= 0 uses one worker per hardware thread.
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    template <typename F>
+    auto submit(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return result;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void enqueue(std::function<void()> task);
+    bool takeTask(int worker, std::function<void()> &task);
+    void workerLoop(int worker);
+
+    std::vector<std::unique_ptr<Queue>> queues; // one per worker
+    Queue injected;                             // submitted from outside the pool
+    std::vector<std::thread> workers;
+    int pending = 0; // queued but not yet taken; guarded by sleepMutex
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};